@@ -1,10 +1,30 @@
 #include <iostream>
 #include <vector>
-#include <stack>
 #include <cmath>
 #include <random>
-#include <queue>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PYRAMINX_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -36,9 +56,11 @@ string resetColor() {
 class Triangle {
 public:
     Color color;
-    std::stack<int> positionHistory;
+    //starting position of the triangle now in this spot, the move history
+    //is kept by Pyraminx only when asked for so copies stay small
+    int position;
 
-    Triangle(Color initialColor) : color(initialColor) {}
+    Triangle(Color initialColor) : color(initialColor), position(-1) {}
 
     bool operator==(const Triangle& other) const {
         return color == other.color;
@@ -48,21 +70,12 @@ public:
         color = newColor;
     }
 
-    void pushPosition(int position) {
-        positionHistory.push(position);
-    }
-
-    void popPosition() {
-        if (!positionHistory.empty()) {
-            positionHistory.pop();
-        }
+    void setPosition(int newPosition) {
+        position = newPosition;
     }
 
     int getCurrentPosition() const {
-        if (!positionHistory.empty()) {
-            return positionHistory.top();
-        }
-        return -1;
+        return position;
     }
 };
 
@@ -101,7 +114,7 @@ public:
                 } else {
                     position = (faceNum * 16) + (j + 9);
                 }
-                face[i][j].pushPosition(position);
+                face[i][j].setPosition(position);
             }
         }
     }
@@ -167,9 +180,41 @@ public:
 class Pyraminx {
 public:
     Face front, left, right, bottom;
+    //undo journal of applied moves, only filled when trackHistory is set
+    bool trackHistory;
+    vector<int> moveHistory;
 
     Pyraminx() 
-        : front(RED, FRONT), left(GREEN, LEFT), right(YELLOW, RIGHT), bottom(BLUE, BOTTOM) {}
+        : front(RED, FRONT), left(GREEN, LEFT), right(YELLOW, RIGHT), bottom(BLUE, BOTTOM), trackHistory(false) {}
+
+    //turn the move journal on or off, turning it off clears it
+    void setTrackHistory(bool track) {
+        trackHistory = track;
+        if (!track) {
+            moveHistory.clear();
+        }
+    }
+
+    //undo the last journaled move, returns false if there is nothing to undo
+    bool undoLastMove() {
+        if (moveHistory.empty()) {
+            return false;
+        }
+        undoMove(moveHistory.back());
+        return true;
+    }
+
+    //undo a move in place, colors and positions go back exactly
+    void undoMove(int move) {
+        bool track = trackHistory;
+        trackHistory = false;
+        //odd moves are the counter-clockwise version of the move before them
+        applyMove(move ^ 1);
+        trackHistory = track;
+        if (trackHistory && !moveHistory.empty() && moveHistory.back() == move) {
+            moveHistory.pop_back();
+        }
+    }
 
     //Prints the pyraminx with the folded out view
     void printPyraminx() {
@@ -183,6 +228,16 @@ public:
         printBottomRows(front.getRow(0), 3);
     }
 
+    //Get the face for the specified face number
+    Face& getFace(int faceNum) {
+        switch (faceNum) {
+            case FRONT: return front;
+            case LEFT: return left;
+            case RIGHT: return right;
+            default: return bottom;
+        }
+    }
+
     bool isSolved() {
         return front.countWrongTriangles() == 0 && left.countWrongTriangles() == 0 && right.countWrongTriangles() == 0 && bottom.countWrongTriangles() == 0;
     }
@@ -217,23 +272,23 @@ public:
     if (isClockwise) {
         // Update positions for clockwise rotation
         leftTop.setColor(frontTopColor);
-        leftTop.pushPosition(frontTopPos);
+        leftTop.setPosition(frontTopPos);
 
         rightTop.setColor(leftTopColor);
-        rightTop.pushPosition(leftTopPos);
+        rightTop.setPosition(leftTopPos);
 
         frontTop.setColor(rightTopColor);
-        frontTop.pushPosition(rightTopPos);
+        frontTop.setPosition(rightTopPos);
     } else {
         // Update positions for counter-clockwise rotation
         leftTop.setColor(rightTopColor);
-        leftTop.pushPosition(rightTopPos);
+        leftTop.setPosition(rightTopPos);
 
         rightTop.setColor(frontTopColor);
-        rightTop.pushPosition(frontTopPos);
+        rightTop.setPosition(frontTopPos);
 
         frontTop.setColor(leftTopColor);
-        frontTop.pushPosition(leftTopPos);
+        frontTop.setPosition(leftTopPos);
     }
 }
 
@@ -255,24 +310,24 @@ public:
     if (isClockwise) {
         
         leftTop.setColor(bottomTopColor);
-        leftTop.pushPosition(bottomTopPos);
+        leftTop.setPosition(bottomTopPos);
 
         bottomTop.setColor(frontTopColor);
-        bottomTop.pushPosition(frontTopPos);
+        bottomTop.setPosition(frontTopPos);
 
         frontTop.setColor(leftTopColor);
-        frontTop.pushPosition(leftTopPos);
+        frontTop.setPosition(leftTopPos);
 
     } else {
         
         leftTop.setColor(frontTopColor);
-        leftTop.pushPosition(frontTopPos);
+        leftTop.setPosition(frontTopPos);
 
         frontTop.setColor(bottomTopColor);
-        frontTop.pushPosition(bottomTopPos);
+        frontTop.setPosition(bottomTopPos);
 
         bottomTop.setColor(leftTopColor);
-        bottomTop.pushPosition(leftTopPos);
+        bottomTop.setPosition(leftTopPos);
     }
 }
 
@@ -293,24 +348,24 @@ public:
     if (isClockwise) {
 
         bottomTop.setColor(rightTopColor);
-        bottomTop.pushPosition(rightTopPos);
+        bottomTop.setPosition(rightTopPos);
 
         rightTop.setColor(frontTopColor);
-        rightTop.pushPosition(frontTopPos);
+        rightTop.setPosition(frontTopPos);
 
         frontTop.setColor(bottomTopColor);
-        frontTop.pushPosition(bottomTopPos);
+        frontTop.setPosition(bottomTopPos);
 
     } else {
 
         bottomTop.setColor(frontTopColor);
-        bottomTop.pushPosition(frontTopPos);
+        bottomTop.setPosition(frontTopPos);
 
         frontTop.setColor(rightTopColor);
-        frontTop.pushPosition(rightTopPos);
+        frontTop.setPosition(rightTopPos);
 
         rightTop.setColor(bottomTopColor);
-        rightTop.pushPosition(bottomTopPos);
+        rightTop.setPosition(bottomTopPos);
     }
 }
 
@@ -331,24 +386,24 @@ public:
     if (isClockwise) {
 
         bottomTop.setColor(leftTopColor);
-        bottomTop.pushPosition(leftTopPos);
+        bottomTop.setPosition(leftTopPos);
 
         rightTop.setColor(bottomTopColor);
-        rightTop.pushPosition(bottomTopPos);
+        rightTop.setPosition(bottomTopPos);
 
         leftTop.setColor(rightTopColor);
-        leftTop.pushPosition(rightTopPos);
+        leftTop.setPosition(rightTopPos);
 
     } else {
 
         bottomTop.setColor(rightTopColor);
-        bottomTop.pushPosition(rightTopPos);
+        bottomTop.setPosition(rightTopPos);
 
         rightTop.setColor(leftTopColor);
-        rightTop.pushPosition(leftTopPos);
+        rightTop.setPosition(leftTopPos);
 
         leftTop.setColor(bottomTopColor);
-        leftTop.pushPosition(bottomTopPos);
+        leftTop.setPosition(bottomTopPos);
     }
 }
 
@@ -380,13 +435,13 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(rightRow[i]->color);
-                frontRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 3; i++) {
@@ -394,13 +449,13 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(leftRow[i]->color);
-                frontRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -428,13 +483,13 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(bottomRow[i]->color);
-                leftRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 3; i++) {
@@ -442,13 +497,13 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(frontRow[i]->color);
-                leftRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -476,13 +531,13 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(frontRow[i]->color);
-                rightRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 3; i++) {
@@ -490,13 +545,13 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(bottomRow[i]->color);
-                rightRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -524,13 +579,13 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(leftRow[i]->color);
-                bottomRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 3; i++) {
@@ -538,13 +593,13 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(rightRow[i]->color);
-                bottomRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -576,13 +631,13 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(rightRow[i]->color);
-                frontRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 5; i++) {
@@ -590,13 +645,13 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(leftRow[i]->color);
-                frontRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -628,13 +683,13 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(frontRow[i]->color);
-                leftRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 5; i++) {
@@ -642,13 +697,13 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(bottomRow[i]->color);
-                leftRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -680,13 +735,13 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(bottomRow[i]->color);
-                rightRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 5; i++) {
@@ -694,13 +749,13 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(frontRow[i]->color);
-                rightRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -732,13 +787,13 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(rightRow[i]->color);
-                bottomRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
             }
         } else {
             for (int i = 0; i < 5; i++) {
@@ -746,13 +801,13 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(leftRow[i]->color);
-                bottomRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
         }
     }
@@ -827,20 +882,20 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(rightRow[i]->color);
-                frontRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
 
             }
 
             // Change face positions and colors to rotated values
             for (int i = 0; i < 16; i++) {
                 bottomFace[i]->setColor(tempBottomColors[changedPositionsClockwise[i]]);
-                bottomFace[i]->pushPosition(tempBottomPositions[changedPositionsClockwise[i]]);
+                bottomFace[i]->setPosition(tempBottomPositions[changedPositionsClockwise[i]]);
             }
 
         } else {
@@ -849,17 +904,17 @@ public:
                 tempPositions[i] = frontRow[i].getCurrentPosition();
 
                 frontRow[i].setColor(leftRow[i]->color);
-                frontRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                frontRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
             for (int i = 0; i < 16; i++) {
                 bottomFace[i]->setColor(tempBottomColors[changedPositionsCounterClockwise[i]]);
-                bottomFace[i]->pushPosition(tempBottomPositions[changedPositionsCounterClockwise[i]]);
+                bottomFace[i]->setPosition(tempBottomPositions[changedPositionsCounterClockwise[i]]);
             }
         }
     }
@@ -927,18 +982,18 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(bottomRow[i]->color);
-                leftRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
 
             }
             for (int i = 0; i < 16; i++) {
                 rightFace[i]->setColor(tempRightColors[changedPositionsClockwise[i]]);
-                rightFace[i]->pushPosition(tempRightPositions[changedPositionsClockwise[i]]);
+                rightFace[i]->setPosition(tempRightPositions[changedPositionsClockwise[i]]);
             }
 
         } else {
@@ -947,17 +1002,17 @@ public:
                 tempPositions[i] = leftRow[i].getCurrentPosition();
 
                 leftRow[i].setColor(frontRow[i]->color);
-                leftRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                leftRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
             }
             for (int i = 0; i < 16; i++) {
                 rightFace[i]->setColor(tempRightColors[changedPositionsCounterClockwise[i]]);
-                rightFace[i]->pushPosition(tempRightPositions[changedPositionsCounterClockwise[i]]);
+                rightFace[i]->setPosition(tempRightPositions[changedPositionsCounterClockwise[i]]);
             }
         }
     }
@@ -1025,18 +1080,18 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(frontRow[i]->color);
-                rightRow[i].pushPosition(frontRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(bottomRow[i]->color);
-                frontRow[i]->pushPosition(bottomRow[i]->getCurrentPosition());
+                frontRow[i]->setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(tempColors[i]);
-                bottomRow[i]->pushPosition(tempPositions[i]);
+                bottomRow[i]->setPosition(tempPositions[i]);
 
             }
             for (int i = 0; i < 16; i++) {
                 leftFace[i]->setColor(tempLeftColors[changedPositionsClockwise[i]]);
-                leftFace[i]->pushPosition(tempLeftPositions[changedPositionsClockwise[i]]);
+                leftFace[i]->setPosition(tempLeftPositions[changedPositionsClockwise[i]]);
             }
 
         } else {
@@ -1045,17 +1100,17 @@ public:
                 tempPositions[i] = rightRow[i].getCurrentPosition();
 
                 rightRow[i].setColor(bottomRow[i]->color);
-                rightRow[i].pushPosition(bottomRow[i]->getCurrentPosition());
+                rightRow[i].setPosition(bottomRow[i]->getCurrentPosition());
 
                 bottomRow[i]->setColor(frontRow[i]->color);
-                bottomRow[i]->pushPosition(frontRow[i]->getCurrentPosition());
+                bottomRow[i]->setPosition(frontRow[i]->getCurrentPosition());
 
                 frontRow[i]->setColor(tempColors[i]);
-                frontRow[i]->pushPosition(tempPositions[i]);
+                frontRow[i]->setPosition(tempPositions[i]);
             }
             for (int i = 0; i < 16; i++) {
                 leftFace[i]->setColor(tempLeftColors[changedPositionsCounterClockwise[i]]);
-                leftFace[i]->pushPosition(tempLeftPositions[changedPositionsCounterClockwise[i]]);
+                leftFace[i]->setPosition(tempLeftPositions[changedPositionsCounterClockwise[i]]);
             }
         }
     }
@@ -1125,18 +1180,18 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(rightRow[i]->color);
-                bottomRow[i].pushPosition(rightRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(leftRow[i]->color);
-                rightRow[i]->pushPosition(leftRow[i]->getCurrentPosition());
+                rightRow[i]->setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(tempColors[i]);
-                leftRow[i]->pushPosition(tempPositions[i]);
+                leftRow[i]->setPosition(tempPositions[i]);
 
             }
             for (int i = 0; i < 16; i++) {
                 frontFace[i]->setColor(tempFrontColors[changedPositionsClockwise[i]]);
-                frontFace[i]->pushPosition(tempFrontPositions[changedPositionsClockwise[i]]);
+                frontFace[i]->setPosition(tempFrontPositions[changedPositionsClockwise[i]]);
             }
 
         } else {
@@ -1145,17 +1200,17 @@ public:
                 tempPositions[i] = bottomRow[i].getCurrentPosition();
 
                 bottomRow[i].setColor(leftRow[i]->color);
-                bottomRow[i].pushPosition(leftRow[i]->getCurrentPosition());
+                bottomRow[i].setPosition(leftRow[i]->getCurrentPosition());
 
                 leftRow[i]->setColor(rightRow[i]->color);
-                leftRow[i]->pushPosition(rightRow[i]->getCurrentPosition());
+                leftRow[i]->setPosition(rightRow[i]->getCurrentPosition());
 
                 rightRow[i]->setColor(tempColors[i]);
-                rightRow[i]->pushPosition(tempPositions[i]);
+                rightRow[i]->setPosition(tempPositions[i]);
             }
             for (int i = 0; i < 16; i++) {
                 frontFace[i]->setColor(tempFrontColors[changedPositionsCounterClockwise[i]]);
-                frontFace[i]->pushPosition(tempFrontPositions[changedPositionsCounterClockwise[i]]);
+                frontFace[i]->setPosition(tempFrontPositions[changedPositionsCounterClockwise[i]]);
             }
         }
     
@@ -1240,6 +1295,9 @@ public:
     }
 
     void applyMove(int move) {
+        if (trackHistory) {
+            moveHistory.push_back(move);
+        }
         switch(move) {
             case 0:
                 rotateTopTip(clockwise);
@@ -1346,220 +1404,3401 @@ public:
         uniform_int_distribution<int> dist(0,31);
         random = dist(rd);
         //cout << "Random: " << random << endl;
-        switch(random) {
-            case 0:
-                rotateTopTip(clockwise);
-                break;
-            case 1:
-                rotateTopTip(counterClockwise);
-                break;
-            case 2:
-                rotateLeftTip(clockwise);
-                break;
-            case 3:
-                rotateLeftTip(counterClockwise);
-                break;
-            case 4:
-                rotateRightTip(clockwise);
-                break;
-            case 5:
-                rotateRightTip(counterClockwise);
-                break;
-            case 6:
-                rotateBackTip(clockwise);
-                break;
-            case 7:
-                rotateBackTip(counterClockwise);
-                break;
-            case 8:
-                rotateFrontSecondRow(clockwise);
-                break;
-            case 9:
-                rotateFrontSecondRow(counterClockwise);
-                break;
-            case 10:
-                rotateLeftSecondRow(clockwise);
-                break;
-            case 11:
-                rotateLeftSecondRow(counterClockwise);
-                break;
-            case 12:
-                rotateRightSecondRow(clockwise);
-                break;
-            case 13:
-                rotateRightSecondRow(counterClockwise);
-                break;
-            case 14:
-                rotateBottomSecondRow(clockwise);
-                break;
-            case 15:
-                rotateBottomSecondRow(counterClockwise);
-                break;
-            case 16:
-                rotateFrontThirdRow(clockwise);
-                break;
-            case 17:
-                rotateFrontThirdRow(counterClockwise);
-                break;
-            case 18:
-                rotateLeftThirdRow(clockwise);
-                break;
-            case 19:
-                rotateLeftThirdRow(counterClockwise);
-                break;
-            case 20:
-                rotateRightThirdRow(clockwise);
-                break;
-            case 21:
-                rotateRightThirdRow(counterClockwise);
-                break;
-            case 22:
-                rotateBottomThirdRow(clockwise);
-                break;
-            case 23:
-                rotateBottomThirdRow(counterClockwise);
-                break;
-            case 24:
-                rotateFrontFourthRow(clockwise);
-                break;
-            case 25:
-                rotateFrontFourthRow(counterClockwise);
-                break;
-            case 26:
-                rotateLeftFourthRow(clockwise);
-                break;
-            case 27:
-                rotateLeftFourthRow(counterClockwise);
-                break;
-            case 28:
-                rotateRightFourthRow(clockwise);
-                break;
-            case 29:
-                rotateRightFourthRow(counterClockwise);
-                break;
-            case 30:
-                rotateBottomFourthRow(clockwise);
-                break;
-            case 31:
-                rotateBottomFourthRow(counterClockwise);
-                break;
-        }
+        applyMove(random);
     }
 
 };
 
-//make the states for the A* algorithm
-struct State {
-    Pyraminx pyraminx;
-    int g;
-    int f;
+// Sticker index for the packed states: face * 16 + row * row + column
+// This is the same numbering as the starting positions pushed in the Face constructor
+int stickerIndex(int faceNum, int row, int column) {
+    return faceNum * 16 + row * row + column;
+}
 
-    bool operator>(const State& other) const {
-        return f > other.f;
+// Move tables recorded from the rotate methods by buildMoveTables()
+// After move m the sticker at index i is the one that was at moveTable[m][i]
+uint8_t moveTable[32][64];
+// The stickers each move actually changes
+int moveChangedCount[32];
+uint8_t moveChanged[32][64];
+// The move that undoes each move
+int inverseMove[32];
+// Stickers each move carries from one face to another, the only ones that change a face's
+// color counts. After move m the sticker at crossFaceGained[m][k] is new on its face and the
+// sticker now at crossFaceLost[m][k] left face crossFaceLostFace[m][k].
+int crossFaceCount[32];
+uint8_t crossFaceGained[32][64];
+uint8_t crossFaceLost[32][64];
+uint8_t crossFaceLostFace[32][64];
+
+void buildMoveTables() {
+    for (int move = 0; move < 32; move++) {
+        //every triangle of a new pyraminx starts labelled with its own index,
+        //so after one move the current positions are the permutation
+        Pyraminx labelled;
+        labelled.applyMove(move);
+        moveChangedCount[move] = 0;
+        for (int f = 0; f < 4; f++) {
+            for (int i = 0; i < 4; i++) {
+                vector<Triangle>& row = labelled.getFace(f).getRow(i);
+                for (size_t j = 0; j < row.size(); j++) {
+                    int index = stickerIndex(f, i, j);
+                    moveTable[move][index] = uint8_t(row[j].getCurrentPosition());
+                    if (moveTable[move][index] != index) {
+                        moveChanged[move][moveChangedCount[move]++] = uint8_t(index);
+                    }
+                }
+            }
+        }
     }
-};
+    //find the inverse of every move from the tables themselves
+    for (int move = 0; move < 32; move++) {
+        inverseMove[move] = -1;
+        for (int other = 0; other < 32 && inverseMove[move] < 0; other++) {
+            bool inverse = true;
+            for (int i = 0; i < 64 && inverse; i++) {
+                inverse = moveTable[other][moveTable[move][i]] == i;
+            }
+            if (inverse) {
+                inverseMove[move] = other;
+            }
+        }
+    }
+    for (int move = 0; move < 32; move++) {
+        int gained = 0;
+        int lost = 0;
+        for (int i = 0; i < 64; i++) {
+            if (moveTable[move][i] / 16 != i / 16) {
+                crossFaceGained[move][gained++] = uint8_t(i);
+            }
+            int destination = moveTable[inverseMove[move]][i];
+            if (destination / 16 != i / 16) {
+                crossFaceLost[move][lost] = uint8_t(destination);
+                crossFaceLostFace[move][lost++] = uint8_t(i / 16);
+            }
+        }
+        crossFaceCount[move] = gained;
+    }
+}
 
-//A* algorithm
-void aStarSolve(Pyraminx& initialPyraminx) {
-    priority_queue<State, vector<State>, greater<State> > openList;
-    unordered_map<string, bool> visited;
-    //track nodes expanded
-    int nodesExpanded = 0;
+// Compact pyraminx with all 64 stickers stored as 2 bit colors
+// Face 0 and 1 live in lo and face 2 and 3 live in hi, 32 bits per face
+struct PackedPyraminx {
+    uint64_t lo;
+    uint64_t hi;
+
+    PackedPyraminx() : lo(0), hi(0) {}
+
+    //pack the colors of a pyraminx
+    explicit PackedPyraminx(Pyraminx& pyraminx) : lo(0), hi(0) {
+        for (int f = 0; f < 4; f++) {
+            for (int i = 0; i < 4; i++) {
+                vector<Triangle>& row = pyraminx.getFace(f).getRow(i);
+                for (size_t j = 0; j < row.size(); j++) {
+                    setSticker(stickerIndex(f, i, j), row[j].color);
+                }
+            }
+        }
+    }
 
-    //initial pyraminx is the initial state of the pyraminx
-    State initialState = {initialPyraminx, 0, initialPyraminx.findHeuristic()};
-    openList.push(initialState);
+    Color getSticker(int index) const {
+        uint64_t word = index < 32 ? lo : hi;
+        return Color((word >> ((index & 31) * 2)) & 3);
+    }
 
-    while(!openList.empty()) {
-        //update for current state
-        State current = openList.top();
-        openList.pop();
-        nodesExpanded++;
-        //current.pyraminx.printPyraminx();
-        if(current.pyraminx.isSolved()) {
-            cout << "Solution found in " << current.g << " moves!" << endl;
-            current.pyraminx.printPyraminx();
-            //Un-comment this line to show how many nodes are expanded for each pyramid
-            //cout << "Nodes Expanded: " << nodesExpanded << endl;
-            return;
+    void setSticker(int index, Color color) {
+        uint64_t& word = index < 32 ? lo : hi;
+        int shift = (index & 31) * 2;
+        word = (word & ~(uint64_t(3) << shift)) | (uint64_t(color) << shift);
+    }
+
+    //the 16 stickers of a face as one 32 bit word
+    uint32_t getFaceBits(int faceNum) const {
+        uint64_t word = faceNum < 2 ? lo : hi;
+        return uint32_t(word >> ((faceNum & 1) * 32));
+    }
+
+    //unpack into a full pyraminx, mostly for printing
+    Pyraminx unpack() const {
+        Pyraminx pyraminx;
+        for (int f = 0; f < 4; f++) {
+            for (int i = 0; i < 4; i++) {
+                vector<Triangle>& row = pyraminx.getFace(f).getRow(i);
+                for (size_t j = 0; j < row.size(); j++) {
+                    row[j].setColor(getSticker(stickerIndex(f, i, j)));
+                }
+            }
         }
+        return pyraminx;
+    }
 
-        //serialize the pyraminx
-        string stateKey = current.pyraminx.serialize();
-        if(visited[stateKey]) {
-            continue;
+    //same move numbers as Pyraminx::applyMove, only the changed stickers are touched
+    void applyMove(int move) {
+        PackedPyraminx old = *this;
+        for (int k = 0; k < moveChangedCount[move]; k++) {
+            int index = moveChanged[move][k];
+            setSticker(index, old.getSticker(moveTable[move][index]));
         }
-        visited[stateKey] = true;
+    }
 
-        for (int i = 0; i < 32; i++) {
-            //try each move and update into a new state
-            Pyraminx nextPyraminx = current.pyraminx;
-            nextPyraminx.applyMove(i);
-            int newG = current.g + 1;
-            int newH = nextPyraminx.findHeuristic();
-            int newF = newG + newH;
+    void undoMove(int move) {
+        applyMove(inverseMove[move]);
+    }
 
-            State newState = {nextPyraminx, newG, newF};
-            openList.push(newState);
+    //solved when every face is a single color (any color on any face, like Pyraminx::isSolved)
+    bool isSolved() const {
+        for (int f = 0; f < 4; f++) {
+            uint32_t face = getFaceBits(f);
+            if (face != (face & 3) * 0x55555555u) {
+                return false;
+            }
         }
+        return true;
     }
 
-    //if no solution is found
-    cout << "No solution found!" << endl;
+    bool operator==(const PackedPyraminx& other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+
+    bool operator!=(const PackedPyraminx& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const PackedPyraminx& other) const {
+        return hi < other.hi || (hi == other.hi && lo < other.lo);
+    }
 };
 
-int main() {
+// Hash for PackedPyraminx so it can be used in the standard containers
+struct PackedPyraminxHash {
+    size_t operator()(const PackedPyraminx& state) const {
+        uint64_t h = state.lo * 0x9E3779B97F4A7C15ull;
+        h ^= (state.hi + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4Full;
+        return size_t(h ^ (h >> 29));
+    }
+};
 
-    //Handles user input to determine how many random moves to perform
-    int userInput = 0;
-    cout << "Input the number of random rotations to perform:" << endl;
-    cin >> userInput;
-    if (userInput < 0) {
-        cout << "Invalid input" << endl;
-        return 1;
+// Finite state automaton over move indices that only lets canonical move sequences through.
+// Its state is the last move made (or START). A move is never followed by another turn of
+// the same layer, since two turns of one layer are one turn or none, and when two layers
+// commute only the order with the lower layer first is kept.
+struct MoveAutomaton {
+    static const int START = 32;
+    //bit m is set when move m may follow
+    uint32_t canonical[33];
+    //only the same layer rule, for searches that drop duplicate states (see aStarSolve)
+    uint32_t nonRedundant[33];
+
+    //needs the move tables, layers are move / 2 like in applyMove
+    void build() {
+        bool commute[16][16];
+        for (int a = 0; a < 16; a++) {
+            for (int b = 0; b < 16; b++) {
+                commute[a][b] = true;
+                for (int i = 0; i < 64 && commute[a][b]; i++) {
+                    commute[a][b] = moveTable[2 * a][moveTable[2 * b][i]] == moveTable[2 * b][moveTable[2 * a][i]];
+                }
+            }
+        }
+        canonical[START] = 0xFFFFFFFFu;
+        nonRedundant[START] = 0xFFFFFFFFu;
+        for (int last = 0; last < 32; last++) {
+            canonical[last] = 0;
+            nonRedundant[last] = 0;
+            for (int move = 0; move < 32; move++) {
+                int lastLayer = last / 2;
+                int layer = move / 2;
+                if (layer == lastLayer) {
+                    continue;
+                }
+                nonRedundant[last] |= 1u << move;
+                if (!(commute[layer][lastLayer] && layer < lastLayer)) {
+                    canonical[last] |= 1u << move;
+                }
+            }
+        }
     }
 
-    //creates the pyraminx in the solved state
-    Pyraminx pyraminx;
-    Pyraminx pyraminx2;
-    Pyraminx pyraminx3;
-    Pyraminx pyraminx4;
-    Pyraminx pyraminx5;
+    bool allows(int lastMove, int move) const {
+        return (canonical[lastMove] >> move) & 1;
+    }
+};
 
-    //calls the randomizer and prints the random moves
-    for (int i = 0; i < userInput; i++) {
-        pyraminx.randomizer();
-        pyraminx2.randomizer();
-        pyraminx3.randomizer();
-        pyraminx4.randomizer();
-        pyraminx5.randomizer();
+MoveAutomaton moveAutomaton;
+
+// Move kernels: each applies one move to 64 sticker bytes in place
+void scalarMoveKernel(uint8_t* sticker, int move) {
+    uint8_t old[64];
+    memcpy(old, sticker, sizeof(old));
+    const uint8_t* table = moveTable[move];
+    for (int i = 0; i < 64; i++) {
+        sticker[i] = old[table[i]];
     }
-    cout << "Pyraminx 1:" << endl;
-    pyraminx.printPyraminx();
-    cout << "Heuristic: " << pyraminx.findHeuristic() << endl;
-    cout << endl << "Pyraminx 2:" << endl;
-    pyraminx2.printPyraminx();
-    cout << "Heuristic: " << pyraminx2.findHeuristic() << endl;
-    cout << endl << "Pyraminx 3:" << endl;
-    pyraminx3.printPyraminx();
-    cout << "Heuristic: " << pyraminx3.findHeuristic() << endl;
-    cout << endl << "Pyraminx 4:" << endl;
-    pyraminx4.printPyraminx();
-    cout << "Heuristic: " << pyraminx4.findHeuristic() << endl;
-    cout << endl << "Pyraminx 5:" << endl;
-    pyraminx5.printPyraminx();
-    cout << "Heuristic: " << pyraminx5.findHeuristic() << endl;
+}
 
-    cout << endl << "Pyraminx 1:" << endl;
-    aStarSolve(pyraminx);
-    cout << endl << "Pyraminx 2:" << endl;
-    aStarSolve(pyraminx2);
-    cout << endl << "Pyraminx 3:" << endl;
-    aStarSolve(pyraminx3);
-    cout << endl << "Pyraminx 4:" << endl;
-    aStarSolve(pyraminx4);
-    cout << endl << "Pyraminx 5:" << endl;
-    aStarSolve(pyraminx5);
+#ifdef PYRAMINX_X86_SIMD
+// pshufb only shuffles inside 16 byte lanes, so every output chunk is the OR of one
+// shuffle per input chunk, with 0x80 zeroing the bytes that come from other chunks
+alignas(16) uint8_t ssse3MoveMasks[32][4][4][16];
+// Same masks for two output chunks at once, input chunks are broadcast to both lanes
+alignas(32) uint8_t avx2MoveMasks[32][2][4][32];
+
+void buildSimdMoveMasks() {
+    for (int move = 0; move < 32; move++) {
+        for (int out = 0; out < 4; out++) {
+            for (int in = 0; in < 4; in++) {
+                for (int b = 0; b < 16; b++) {
+                    int source = moveTable[move][out * 16 + b];
+                    uint8_t mask = (source / 16 == in) ? uint8_t(source % 16) : uint8_t(0x80);
+                    ssse3MoveMasks[move][out][in][b] = mask;
+                    avx2MoveMasks[move][out / 2][in][(out % 2) * 16 + b] = mask;
+                }
+            }
+        }
+    }
+}
+
+__attribute__((target("ssse3")))
+void ssse3MoveKernel(uint8_t* sticker, int move) {
+    __m128i in[4];
+    for (int j = 0; j < 4; j++) {
+        in[j] = _mm_loadu_si128((const __m128i*)(sticker + j * 16));
+    }
+    for (int k = 0; k < 4; k++) {
+        __m128i out = _mm_setzero_si128();
+        for (int j = 0; j < 4; j++) {
+            __m128i mask = _mm_load_si128((const __m128i*)ssse3MoveMasks[move][k][j]);
+            out = _mm_or_si128(out, _mm_shuffle_epi8(in[j], mask));
+        }
+        _mm_storeu_si128((__m128i*)(sticker + k * 16), out);
+    }
+}
+
+__attribute__((target("avx2")))
+void avx2MoveKernel(uint8_t* sticker, int move) {
+    __m256i in[4];
+    for (int j = 0; j < 4; j++) {
+        in[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(sticker + j * 16)));
+    }
+    __m256i out[2];
+    for (int k = 0; k < 2; k++) {
+        out[k] = _mm256_setzero_si256();
+        for (int j = 0; j < 4; j++) {
+            __m256i mask = _mm256_load_si256((const __m256i*)avx2MoveMasks[move][k][j]);
+            out[k] = _mm256_or_si256(out[k], _mm256_shuffle_epi8(in[j], mask));
+        }
+    }
+    _mm256_storeu_si256((__m256i*)sticker, out[0]);
+    _mm256_storeu_si256((__m256i*)(sticker + 32), out[1]);
+}
+
+//vpermb does the whole 64 byte permutation with the move table as the index, the zero masking
+//form with every lane set has no undefined source operand for the compiler to warn about
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+void avx512MoveKernel(uint8_t* sticker, int move) {
+    __m512i index = _mm512_loadu_si512((const void*)moveTable[move]);
+    __m512i in = _mm512_loadu_si512((const void*)sticker);
+    _mm512_storeu_si512((void*)sticker, _mm512_maskz_permutexvar_epi8(~(__mmask64)0, index, in));
+}
+#endif
+
+void (*moveKernel)(uint8_t* sticker, int move) = scalarMoveKernel;
+string moveKernelName = "scalar";
+
+//pick the widest instruction set the cpu supports, needs the move tables
+void initMoveKernel() {
+    moveKernel = scalarMoveKernel;
+    moveKernelName = "scalar";
+#ifdef PYRAMINX_X86_SIMD
+    buildSimdMoveMasks();
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw")) {
+        moveKernel = avx512MoveKernel;
+        moveKernelName = "avx512vbmi";
+    } else if (__builtin_cpu_supports("avx2")) {
+        moveKernel = avx2MoveKernel;
+        moveKernelName = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        moveKernel = ssse3MoveKernel;
+        moveKernelName = "ssse3";
+    }
+#endif
+}
+
+// Color count kernels: colorCount[face * 4 + color] for the 64 sticker bytes, the counts the
+// sticker heuristic is worked out from
+void scalarColorCountKernel(const uint8_t* sticker, uint8_t* colorCount) {
+    memset(colorCount, 0, 16);
+    for (int i = 0; i < 64; i++) {
+        colorCount[(i / 16) * 4 + sticker[i]]++;
+    }
+}
+
+#ifdef PYRAMINX_X86_SIMD
+//one compare per face and color, the set bits of the byte mask are the count
+__attribute__((target("sse2,popcnt")))
+void sse2ColorCountKernel(const uint8_t* sticker, uint8_t* colorCount) {
+    for (int f = 0; f < 4; f++) {
+        __m128i face = _mm_loadu_si128((const __m128i*)(sticker + f * 16));
+        for (int color = 0; color < 4; color++) {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(face, _mm_set1_epi8(char(color))));
+            colorCount[f * 4 + color] = uint8_t(_mm_popcnt_u32(uint32_t(mask)));
+        }
+    }
+}
+
+//two faces per compare, the low and high 16 bits of the mask belong to one face each
+__attribute__((target("avx2,popcnt")))
+void avx2ColorCountKernel(const uint8_t* sticker, uint8_t* colorCount) {
+    for (int half = 0; half < 2; half++) {
+        __m256i faces = _mm256_loadu_si256((const __m256i*)(sticker + half * 32));
+        for (int color = 0; color < 4; color++) {
+            uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(faces, _mm256_set1_epi8(char(color)))));
+            colorCount[half * 8 + color] = uint8_t(_mm_popcnt_u32(mask & 0xFFFF));
+            colorCount[half * 8 + 4 + color] = uint8_t(_mm_popcnt_u32(mask >> 16));
+        }
+    }
+}
+#endif
+
+// The same counts split by sticker class, colorCount[c * 16 + face * 4 + color] counts the
+// stickers in classMasks[c]
+void scalarClassColorCountKernel(const uint8_t* sticker, const uint64_t* classMasks, int classCount, uint8_t* colorCount) {
+    memset(colorCount, 0, classCount * 16);
+    for (int c = 0; c < classCount; c++) {
+        for (int i = 0; i < 64; i++) {
+            if ((classMasks[c] >> i) & 1) {
+                colorCount[c * 16 + (i / 16) * 4 + sticker[i]]++;
+            }
+        }
+    }
+}
 
+#ifdef PYRAMINX_X86_SIMD
+//a 64 bit mask of the stickers of each color, then one popcount per class, face and color
+__attribute__((target("avx2,popcnt")))
+void avx2ClassColorCountKernel(const uint8_t* sticker, const uint64_t* classMasks, int classCount, uint8_t* colorCount) {
+    __m256i low = _mm256_loadu_si256((const __m256i*)sticker);
+    __m256i high = _mm256_loadu_si256((const __m256i*)(sticker + 32));
+    uint64_t colorMask[4];
+    for (int color = 0; color < 4; color++) {
+        __m256i value = _mm256_set1_epi8(char(color));
+        colorMask[color] = uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, value)))) |
+                           uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, value)))) << 32;
+    }
+    for (int c = 0; c < classCount; c++) {
+        for (int color = 0; color < 4; color++) {
+            uint64_t mask = colorMask[color] & classMasks[c];
+            for (int f = 0; f < 4; f++) {
+                colorCount[c * 16 + f * 4 + color] = uint8_t(_mm_popcnt_u32(uint32_t(mask >> (f * 16)) & 0xFFFF));
+            }
+        }
+    }
+}
+#endif
+
+void (*colorCountKernel)(const uint8_t* sticker, uint8_t* colorCount) = scalarColorCountKernel;
+void (*classColorCountKernel)(const uint8_t* sticker, const uint64_t* classMasks, int classCount, uint8_t* colorCount)
+    = scalarClassColorCountKernel;
+
+void initColorCountKernel() {
+    colorCountKernel = scalarColorCountKernel;
+    classColorCountKernel = scalarClassColorCountKernel;
+#ifdef PYRAMINX_X86_SIMD
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("popcnt")) {
+        return;
+    }
+    //avx512bw needs twice the popcounts for the same compares and came out slower than avx2
+    if (__builtin_cpu_supports("avx2")) {
+        colorCountKernel = avx2ColorCountKernel;
+        classColorCountKernel = avx2ClassColorCountKernel;
+    } else if (__builtin_cpu_supports("sse2")) {
+        colorCountKernel = sse2ColorCountKernel;
+    }
+#endif
+}
+
+//build every table the solvers share
+void initSolverTables() {
+    buildMoveTables();
+    initMoveKernel();
+    initColorCountKernel();
+    moveAutomaton.build();
+}
+
+// All 64 stickers one byte each, the working form for applying moves
+struct alignas(64) StickerArray {
+    uint8_t sticker[64];
+
+    StickerArray() {
+        memset(sticker, 0, sizeof(sticker));
+    }
+
+    explicit StickerArray(const PackedPyraminx& packed) {
+        for (int i = 0; i < 64; i++) {
+            sticker[i] = uint8_t(packed.getSticker(i));
+        }
+    }
+
+    PackedPyraminx pack() const {
+        PackedPyraminx packed;
+        for (int i = 0; i < 32; i++) {
+            packed.lo |= uint64_t(sticker[i]) << (i * 2);
+            packed.hi |= uint64_t(sticker[i + 32]) << (i * 2);
+        }
+        return packed;
+    }
+
+    //one gather through the move table, using the kernel picked by initMoveKernel()
+    void applyMove(int move) {
+        moveKernel(sticker, move);
+    }
+
+    void undoMove(int move) {
+        moveKernel(sticker, inverseMove[move]);
+    }
+
+    bool isSolved() const {
+        for (int i = 0; i < 64; i++) {
+            if (sticker[i] != sticker[i & ~15]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator==(const StickerArray& other) const {
+        return memcmp(sticker, other.sticker, sizeof(sticker)) == 0;
+    }
+};
+
+// Search state with optional piece tracking. identity holds the starting index of the
+// sticker in each spot (what Triangle::getCurrentPosition() reports) and is only
+// moved along when trackIdentity is set, otherwise a move touches the colors alone
+struct SearchState {
+    StickerArray colors;
+    StickerArray identity;
+    bool trackIdentity;
+
+    explicit SearchState(Pyraminx& pyraminx, bool track = false) : colors(PackedPyraminx(pyraminx)), trackIdentity(track) {
+        for (int f = 0; f < 4; f++) {
+            for (int i = 0; i < 4; i++) {
+                vector<Triangle>& row = pyraminx.getFace(f).getRow(i);
+                for (size_t j = 0; j < row.size(); j++) {
+                    identity.sticker[stickerIndex(f, i, j)] = uint8_t(row[j].getCurrentPosition());
+                }
+            }
+        }
+    }
+
+    //make and unmake a move in place, so depth first searches never copy the state
+    void applyMove(int move) {
+        colors.applyMove(move);
+        if (trackIdentity) {
+            identity.applyMove(move);
+        }
+    }
+
+    void undoMove(int move) {
+        colors.undoMove(move);
+        if (trackIdentity) {
+            identity.undoMove(move);
+        }
+    }
+
+    bool isSolved() const {
+        return colors.isSolved();
+    }
+};
+
+// Sticker permutation in the same gather form as the move tables
+typedef array<uint8_t, 64> StickerPermutation;
+
+//permutation for doing first and then second
+StickerPermutation composePermutations(const StickerPermutation& first, const StickerPermutation& second) {
+    StickerPermutation result;
+    for (int i = 0; i < 64; i++) {
+        result[i] = first[second[i]];
+    }
+    return result;
+}
+
+StickerPermutation invertPermutation(const StickerPermutation& permutation) {
+    StickerPermutation result;
+    for (int i = 0; i < 64; i++) {
+        result[permutation[i]] = uint8_t(i);
+    }
+    return result;
+}
+
+StickerPermutation movePermutation(int move) {
+    StickerPermutation result;
+    memcpy(result.data(), moveTable[move], 64);
+    return result;
+}
+
+// Symmetries of the puzzle as sticker permutations, used to map equivalent states onto one
+// representative before they are hashed. A permutation only counts as a symmetry when it
+// sends faces to faces (so solved stays solved) and turns every move into a move when the
+// puzzle is turned by it, otherwise a state and its image would not be the same distance
+// from solved.
+class SymmetryGroup {
+public:
+    vector<StickerPermutation> symmetries;
+
+    SymmetryGroup() : relabelColors(false) {
+        symmetries.push_back(identity());
+    }
+
+    //The 12 orientations come from turning all four layers of one axis together (the tip,
+    //second, third and fourth row moves with the same position in applyMove). The direction
+    //of each layer is whatever makes the whole puzzle move as one block. Candidates that are
+    //not real symmetries of the move tables are dropped, and the group stays as it was.
+    void addOrientations() {
+        vector<StickerPermutation> generators;
+        for (int axis = 0; axis < 4; axis++) {
+            for (int directions = 0; directions < 16; directions++) {
+                StickerPermutation rotation = identity();
+                for (int layer = 0; layer < 4; layer++) {
+                    int move = (axis + 4 * layer) * 2 + ((directions >> layer) & 1);
+                    rotation = composePermutations(rotation, movePermutation(move));
+                }
+                if (isSymmetry(rotation)) {
+                    generators.push_back(rotation);
+                }
+            }
+        }
+        addGenerated(generators, 12);
+    }
+
+    //Every symmetry of the move tables, found by a backtracking search that places one
+    //sticker at a time along the move cycles. Besides orientations this finds mirror
+    //images, which turn clockwise moves into counter-clockwise ones.
+    void addMoveTableSymmetries() {
+        //arrowMoves[a][b] has bit m set when move m brings the sticker at b to a
+        vector<vector<uint32_t> > arrowMoves(64, vector<uint32_t>(64, 0));
+        for (int move = 0; move < 32; move++) {
+            for (int i = 0; i < 64; i++) {
+                arrowMoves[i][moveTable[move][i]] |= 1u << move;
+            }
+        }
+        //place stickers in an order where each one is linked by a move to one placed before
+        vector<int> order;
+        vector<bool> ordered(64, false);
+        for (int start = 0; start < 64; start++) {
+            if (ordered[start]) {
+                continue;
+            }
+            ordered[start] = true;
+            order.push_back(start);
+            for (size_t next = order.size() - 1; next < order.size(); next++) {
+                for (int move = 0; move < 32; move++) {
+                    int linked = moveTable[move][order[next]];
+                    if (!ordered[linked]) {
+                        ordered[linked] = true;
+                        order.push_back(linked);
+                    }
+                }
+            }
+        }
+        vector<int> image(64, -1);
+        vector<bool> used(64, false);
+        vector<uint32_t> candidates(32, 0xFFFFFFFFu);
+        vector<StickerPermutation> found;
+        searchSymmetries(order, 0, image, used, candidates, arrowMoves, found);
+        for (size_t i = 0; i < found.size(); i++) {
+            if (isSymmetry(found[i]) && find(symmetries.begin(), symmetries.end(), found[i]) == symmetries.end()) {
+                symmetries.push_back(found[i]);
+            }
+        }
+        addGenerated(symmetries, 24);
+    }
+
+    //Relabeling colors keeps distances too (solved only asks for one color per face), so
+    //with this set every state is also reduced to its colors in order of first appearance
+    void setColorRelabeling(bool relabel) {
+        relabelColors = relabel;
+    }
+
+    size_t size() const {
+        return symmetries.size() * (relabelColors ? 24 : 1);
+    }
+
+    //the smallest packed image of the state over the group
+    PackedPyraminx canonicalize(const StickerArray& stickers) const {
+        if (!relabelColors && symmetries.size() == 1) {
+            return stickers.pack();
+        }
+        PackedPyraminx best;
+        for (size_t s = 0; s < symmetries.size(); s++) {
+            StickerArray image;
+            for (int i = 0; i < 64; i++) {
+                image.sticker[i] = stickers.sticker[symmetries[s][i]];
+            }
+            if (relabelColors) {
+                relabel(image);
+            }
+            PackedPyraminx packed = image.pack();
+            if (s == 0 || packed < best) {
+                best = packed;
+            }
+        }
+        return best;
+    }
+
+    //rename colors to 0, 1, 2, 3 in the order they first show up
+    static void relabel(StickerArray& stickers) {
+        uint8_t newColor[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+        uint8_t nextColor = 0;
+        for (int i = 0; i < 64; i++) {
+            uint8_t& color = stickers.sticker[i];
+            if (newColor[color] == 0xFF) {
+                newColor[color] = nextColor++;
+            }
+            color = newColor[color];
+        }
+    }
+
+    static StickerPermutation identity() {
+        StickerPermutation result;
+        for (int i = 0; i < 64; i++) {
+            result[i] = uint8_t(i);
+        }
+        return result;
+    }
+
+    //faces go to whole faces and every move turned by the permutation is a move again
+    static bool isSymmetry(const StickerPermutation& permutation) {
+        for (int f = 0; f < 4; f++) {
+            for (int i = 1; i < 16; i++) {
+                if (permutation[f * 16 + i] / 16 != permutation[f * 16] / 16) {
+                    return false;
+                }
+            }
+        }
+        StickerPermutation inverse = invertPermutation(permutation);
+        for (int move = 0; move < 32; move++) {
+            StickerPermutation conjugate = composePermutations(composePermutations(inverse, movePermutation(move)), permutation);
+            bool found = false;
+            for (int other = 0; other < 32 && !found; other++) {
+                found = conjugate == movePermutation(other);
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool relabelColors;
+
+    void searchSymmetries(const vector<int>& order, size_t placed, vector<int>& image, vector<bool>& used,
+                          vector<uint32_t>& candidates, const vector<vector<uint32_t> >& arrowMoves,
+                          vector<StickerPermutation>& found) {
+        if (placed == order.size()) {
+            StickerPermutation permutation;
+            for (int i = 0; i < 64; i++) {
+                permutation[i] = uint8_t(image[i]);
+            }
+            found.push_back(permutation);
+            return;
+        }
+        int sticker = order[placed];
+        for (int target = 0; target < 64; target++) {
+            //faces have to land on whole faces
+            if (used[target] || !faceFits(image, sticker, target)) {
+                continue;
+            }
+            image[sticker] = target;
+            //every move has to keep mapping onto one single move
+            vector<uint32_t> saved = candidates;
+            bool consistent = true;
+            for (int move = 0; move < 32 && consistent; move++) {
+                int from = moveTable[move][sticker];
+                int to = moveTable[inverseMove[move]][sticker];
+                if (image[from] >= 0) {
+                    candidates[move] &= arrowMoves[target][image[from]];
+                }
+                if (image[to] >= 0) {
+                    candidates[move] &= arrowMoves[image[to]][target];
+                }
+                consistent = candidates[move] != 0;
+            }
+            if (consistent) {
+                used[target] = true;
+                searchSymmetries(order, placed + 1, image, used, candidates, arrowMoves, found);
+                used[target] = false;
+            }
+            candidates = saved;
+            image[sticker] = -1;
+        }
+    }
+
+    //true when placing sticker at target keeps every face going to a single face
+    static bool faceFits(const vector<int>& image, int sticker, int target) {
+        for (int i = 0; i < 64; i++) {
+            if (image[i] < 0) {
+                continue;
+            }
+            bool sameFace = i / 16 == sticker / 16;
+            bool sameTargetFace = image[i] / 16 == target / 16;
+            if (sameFace != sameTargetFace) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //close the group under the generators, giving up on them if it grows past maxSize
+    void addGenerated(const vector<StickerPermutation>& generators, size_t maxSize) {
+        vector<StickerPermutation> group = symmetries;
+        for (size_t next = 0; next < group.size(); next++) {
+            for (size_t g = 0; g < generators.size(); g++) {
+                StickerPermutation product = composePermutations(group[next], generators[g]);
+                if (find(group.begin(), group.end(), product) == group.end()) {
+                    if (group.size() >= maxSize) {
+                        return;
+                    }
+                    group.push_back(product);
+                }
+            }
+        }
+        symmetries = group;
+    }
+};
+
+SymmetryGroup symmetryGroup;
+
+//symmetries only change how states are keyed, so they are set up on request
+void initSymmetries(bool orientations, bool mirrorsAndColors) {
+    symmetryGroup = SymmetryGroup();
+    if (orientations) {
+        symmetryGroup.addOrientations();
+    }
+    if (mirrorsAndColors) {
+        symmetryGroup.addMoveTableSymmetries();
+        symmetryGroup.setColorRelabeling(true);
+    }
+}
+
+// Values a heuristic keeps for each search node, so a child can be evaluated from its parent
+const int HEURISTIC_CACHE_SIZE = 32;
+
+struct HeuristicCache {
+    uint8_t value[HEURISTIC_CACHE_SIZE];
+};
+
+// Lower bound on the number of moves left, used by the searches that work on sticker arrays
+class Heuristic {
+public:
+    virtual ~Heuristic() {}
+    virtual int evaluate(const StickerArray& stickers) const = 0;
+
+    //whether A* has to store every node's cache, otherwise it rebuilds the cache of the node it
+    //expands with evaluateRoot, once per expansion instead of once per child
+    virtual bool storeNodeCaches() const {
+        return false;
+    }
+
+    //evaluate a start state and fill its cache
+    virtual int evaluateRoot(const StickerArray& stickers, HeuristicCache&) const {
+        return evaluate(stickers);
+    }
+
+    //evaluate the child that move made from a state with parentCache, and fill the child's cache
+    virtual int evaluateChild(const StickerArray& child, int, const HeuristicCache&, HeuristicCache&) const {
+        return evaluate(child);
+    }
+};
+
+// The bound from Pyraminx::findHeuristic: triangles that are not their face's most common
+// color, divided by 21 (the most triangles one move can take off a face)
+// The cache holds the color counts of every face, a child only updates the counts for the
+// stickers its move carried to another face.
+class StickerHeuristic : public Heuristic {
+public:
+    //cache bytes used, colorCount[face * 4 + color]
+    static const int CACHE_BYTES = 16;
+
+    int evaluate(const StickerArray& stickers) const {
+        HeuristicCache cache;
+        return evaluateRoot(stickers, cache);
+    }
+
+    int evaluateRoot(const StickerArray& stickers, HeuristicCache& cache) const {
+        colorCountKernel(stickers.sticker, cache.value);
+        return boundFromCounts(cache);
+    }
+
+    int evaluateChild(const StickerArray& child, int move, const HeuristicCache& parentCache, HeuristicCache& cache) const {
+        memcpy(cache.value, parentCache.value, CACHE_BYTES);
+        for (int k = 0; k < crossFaceCount[move]; k++) {
+            int gained = crossFaceGained[move][k];
+            cache.value[(gained / 16) * 4 + child.sticker[gained]]++;
+            cache.value[crossFaceLostFace[move][k] * 4 + child.sticker[crossFaceLost[move][k]]]--;
+        }
+        return boundFromCounts(cache);
+    }
+
+private:
+    static int boundFromCounts(const HeuristicCache& cache) {
+        int wrongTriangles = 0;
+        for (int f = 0; f < 4; f++) {
+            const uint8_t* colorCount = cache.value + f * 4;
+            int faceColorCount = max(max(colorCount[0], colorCount[1]), max(colorCount[2], colorCount[3]));
+            wrongTriangles += 16 - faceColorCount;
+        }
+        return (wrongTriangles + 20) / 21;
+    }
+};
+
+// 64 bit FNV-1a hash, for the checksums and layout hashes in table files
+uint64_t fnv1aHash(const void* bytes, size_t length, uint64_t hash = 0xCBF29CE484222325ull) {
+    const uint8_t* p = (const uint8_t*)bytes;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ p[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+//hash of the move tables, files built for different moves are not used
+uint64_t puzzleLayoutHash() {
+    return fnv1aHash(moveTable, sizeof(moveTable));
+}
+
+// Sets of sticker positions the moves can carry a sticker between, from the move tables
+vector<vector<int> > findStickerOrbits() {
+    int orbitOf[64];
+    for (int i = 0; i < 64; i++) {
+        orbitOf[i] = i;
+    }
+    //merge until nothing changes, every orbit ends up labelled by its smallest sticker
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int move = 0; move < 32; move++) {
+            for (int i = 0; i < 64; i++) {
+                int other = moveTable[move][i];
+                int label = min(orbitOf[i], orbitOf[other]);
+                if (orbitOf[i] != label || orbitOf[other] != label) {
+                    orbitOf[i] = label;
+                    orbitOf[other] = label;
+                    changed = true;
+                }
+            }
+        }
+    }
+    vector<vector<int> > orbits;
+    for (int i = 0; i < 64; i++) {
+        if (orbitOf[i] == i) {
+            orbits.push_back(vector<int>());
+            for (int j = 0; j < 64; j++) {
+                if (orbitOf[j] == i) {
+                    orbits.back().push_back(j);
+                }
+            }
+        }
+    }
+    return orbits;
+}
+
+//the orbit a sticker belongs to
+vector<int> stickerOrbit(int sticker) {
+    vector<vector<int> > orbits = findStickerOrbits();
+    for (size_t i = 0; i < orbits.size(); i++) {
+        if (find(orbits[i].begin(), orbits[i].end(), sticker) != orbits[i].end()) {
+            return orbits[i];
+        }
+    }
+    return vector<int>();
+}
+
+// A sticker bound that counts by location class. Every move keeps stickers in their orbit, so
+// each orbit has its own deficit: the stickers of the orbit that are not the most common orbit
+// color on their face. A move lowers an orbit's deficit by at most the number of orbit stickers
+// it carries onto another face, which the move tables give per move. Any weights w with
+// sum(w[c] * carried[m][c]) <= 1 for every move m make sum(w[c] * deficit[c]) a lower bound on
+// the moves left. The weights are searched on a grid when the heuristic is built, and the best
+// of them for every combination of deficits goes in a table. The bound is the table entry or
+// findHeuristic's own bound, whichever is larger.
+class ClassStickerHeuristic : public Heuristic {
+public:
+    ClassStickerHeuristic() : classCount(0) {
+        //orbits with one sticker per face can never be off their face's color
+        vector<vector<int> > orbits = findStickerOrbits();
+        uint8_t stickerClass[64];
+        int classSize[MAX_CLASSES];
+        for (size_t o = 0; o < orbits.size(); o++) {
+            if (orbits[o].size() > 4) {
+                classSize[classCount] = int(orbits[o].size());
+                classMasks[classCount] = 0;
+                for (size_t k = 0; k < orbits[o].size(); k++) {
+                    stickerClass[orbits[o][k]] = uint8_t(classCount);
+                    classMasks[classCount] |= uint64_t(1) << orbits[o][k];
+                }
+                classCount++;
+            } else {
+                for (size_t k = 0; k < orbits[o].size(); k++) {
+                    stickerClass[orbits[o][k]] = NO_CLASS;
+                }
+            }
+        }
+        int carried[32][MAX_CLASSES];
+        memset(carried, 0, sizeof(carried));
+        for (int move = 0; move < 32; move++) {
+            for (int i = 0; i < 64; i++) {
+                if (moveTable[move][i] / 16 != i / 16 && stickerClass[i] != NO_CLASS) {
+                    carried[move][stickerClass[i]]++;
+                }
+            }
+        }
+        vector<array<int, MAX_CLASSES> > weights = findWeights(carried);
+
+        //a class's deficit is never more than its size
+        size_t tableSize = 1;
+        for (int c = 0; c < classCount; c++) {
+            tableSize *= classSize[c] + 1;
+        }
+        boundTable.assign(tableSize, 0);
+        for (size_t index = 0; index < tableSize; index++) {
+            int deficit[MAX_CLASSES];
+            size_t rest = index;
+            for (int c = classCount - 1; c >= 0; c--) {
+                deficit[c] = int(rest % (classSize[c] + 1));
+                rest /= classSize[c] + 1;
+            }
+            int best = 0;
+            for (size_t w = 0; w < weights.size(); w++) {
+                int sum = 0;
+                for (int c = 0; c < classCount; c++) {
+                    sum += weights[w][c] * deficit[c];
+                }
+                best = max(best, sum);
+            }
+            boundTable[index] = uint8_t((best + WEIGHT_SCALE - 1) / WEIGHT_SCALE);
+        }
+        for (int c = 0; c < classCount; c++) {
+            classRadix[c] = classSize[c] + 1;
+        }
+    }
+
+    int evaluate(const StickerArray& stickers) const {
+        return max(stickerHeuristic.evaluate(stickers), classBound(stickers));
+    }
+
+    //the findHeuristic part is kept up to date in the cache like StickerHeuristic does
+    int evaluateRoot(const StickerArray& stickers, HeuristicCache& cache) const {
+        return max(stickerHeuristic.evaluateRoot(stickers, cache), classBound(stickers));
+    }
+
+    int evaluateChild(const StickerArray& child, int move, const HeuristicCache& parentCache, HeuristicCache& cache) const {
+        return max(stickerHeuristic.evaluateChild(child, move, parentCache, cache), classBound(child));
+    }
+
+private:
+    static const int MAX_CLASSES = 4;
+    static const uint8_t NO_CLASS = 0xFF;
+    //weights are multiples of 1 / WEIGHT_SCALE
+    static const int WEIGHT_SCALE = 72;
+
+    uint64_t classMasks[MAX_CLASSES];
+    int classRadix[MAX_CLASSES];
+    int classCount;
+    //bound for each combination of class deficits, in mixed radix classRadix
+    vector<uint8_t> boundTable;
+    StickerHeuristic stickerHeuristic;
+
+    int classBound(const StickerArray& stickers) const {
+        uint8_t colorCount[MAX_CLASSES * 16];
+        classColorCountKernel(stickers.sticker, classMasks, classCount, colorCount);
+        size_t index = 0;
+        for (int c = 0; c < classCount; c++) {
+            int deficit = 0;
+            for (int f = 0; f < 4; f++) {
+                const uint8_t* count = colorCount + c * 16 + f * 4;
+                deficit += count[0] + count[1] + count[2] + count[3] - max(max(count[0], count[1]), max(count[2], count[3]));
+            }
+            index = index * classRadix[c] + deficit;
+        }
+        return boundTable[index];
+    }
+
+    //the weight vectors no other allowed vector beats in every class
+    vector<array<int, MAX_CLASSES> > findWeights(const int carried[32][MAX_CLASSES]) const {
+        vector<array<int, MAX_CLASSES> > weights;
+        vector<array<int, MAX_CLASSES> > allowed;
+        array<int, MAX_CLASSES> w = {{0, 0, 0, 0}};
+        enumerateWeights(carried, 0, w, allowed);
+        for (size_t a = 0; a < allowed.size(); a++) {
+            bool beaten = false;
+            for (size_t b = 0; b < allowed.size() && !beaten; b++) {
+                bool atLeast = a != b;
+                for (int c = 0; c < classCount && atLeast; c++) {
+                    atLeast = allowed[b][c] >= allowed[a][c];
+                }
+                beaten = atLeast && allowed[b] != allowed[a];
+            }
+            if (!beaten) {
+                weights.push_back(allowed[a]);
+            }
+        }
+        return weights;
+    }
+
+    //every class gets the largest weight left for it, the last class always takes all that fits
+    void enumerateWeights(const int carried[32][MAX_CLASSES], int c, array<int, MAX_CLASSES>& w,
+                          vector<array<int, MAX_CLASSES> >& allowed) const {
+        int largest = WEIGHT_SCALE;
+        for (int move = 0; move < 32; move++) {
+            if (carried[move][c] == 0) {
+                continue;
+            }
+            int used = 0;
+            for (int other = 0; other < c; other++) {
+                used += w[other] * carried[move][other];
+            }
+            largest = min(largest, (WEIGHT_SCALE - used) / carried[move][c]);
+        }
+        if (c == classCount - 1) {
+            w[c] = largest;
+            allowed.push_back(w);
+            return;
+        }
+        for (w[c] = 0; w[c] <= largest; w[c]++) {
+            enumerateWeights(carried, c + 1, w, allowed);
+        }
+        w[c] = 0;
+    }
+};
+
+uint64_t binomial(int n, int k) {
+    static uint64_t table[65][65];
+    static bool built = false;
+    if (!built) {
+        for (int i = 0; i <= 64; i++) {
+            table[i][0] = 1;
+            for (int j = 1; j <= i; j++) {
+                table[i][j] = table[i - 1][j - 1] + (j < i ? table[i - 1][j] : 0);
+            }
+        }
+        built = true;
+    }
+    if (k < 0 || k > n) {
+        return 0;
+    }
+    return table[n][k];
+}
+
+// Colors as seen by a pattern database, colors mapped to the same symbol can not be told apart
+typedef array<uint8_t, 4> ColorMap;
+
+// Table entry for patterns the search has not reached
+const uint8_t UNSEEN = 0xFF;
+
+// How table entries are stored. Nibbles cap the stored distance at 15, which keeps the bound
+// admissible. Mod 3 keeps only the distance mod 3: the distances of a pattern and its neighbors
+// differ by at most one, so a child's distance follows from its parent's.
+enum PatternEncoding {
+    BYTE_ENCODING = 0,
+    NIBBLE_ENCODING = 1,
+    MOD3_ENCODING = 2
+};
+
+// Pattern database over an abstraction of the puzzle: the stickers in some orbits, with their
+// colors mapped to symbols. Every move keeps stickers inside their orbit, so the number of each
+// symbol never changes and a pattern is ranked as a multiset permutation. The table holds the
+// exact number of moves from each pattern to a solved one, found by a breadth first search
+// back from the solved patterns. A table built with one color map also answers for the color
+// maps that only swap colors around, since every coloring of the solved faces is a start.
+// When every symbol is used equally often, renaming symbols keeps the distance, so those tables
+// are keyed on the pattern with its symbols renamed in order of first appearance (the color
+// relabeling of SymmetryGroup), which is a symbols factorial fewer entries.
+class PatternDatabase {
+public:
+    string name;
+    vector<int> positions;
+    //the table is built with lookupMaps[0], lookups take the max over all of them
+    vector<ColorMap> lookupMaps;
+    //bit m is set when move m changes the pattern
+    uint32_t affectingMoves;
+    //the moves that cost one, the other moves that change the pattern are free here because
+    //another database of the same partition pays for them
+    uint32_t countedMoves;
+
+    PatternDatabase(const string& databaseName, const vector<int>& patternPositions, const vector<ColorMap>& colorMaps,
+                    uint32_t chargedMoves = 0xFFFFFFFFu)
+        : name(databaseName), positions(patternPositions), lookupMaps(colorMaps), affectingMoves(0), countedMoves(0),
+          symbolKinds(0), relabelSymbols(false), encoding(BYTE_ENCODING), data(NULL), maxDepth(0) {
+        int localIndex[64];
+        for (int i = 0; i < 64; i++) {
+            localIndex[i] = -1;
+        }
+        for (size_t k = 0; k < positions.size(); k++) {
+            localIndex[positions[k]] = int(k);
+        }
+        //local moves: after move m the k-th position holds what was at localMoves[m][k]
+        localMoves.assign(32, vector<uint8_t>(positions.size()));
+        for (int move = 0; move < 32; move++) {
+            for (size_t k = 0; k < positions.size(); k++) {
+                localMoves[move][k] = uint8_t(localIndex[moveTable[move][positions[k]]]);
+                if (localMoves[move][k] != k) {
+                    affectingMoves |= 1u << move;
+                }
+            }
+        }
+        countedMoves = affectingMoves & chargedMoves;
+        //symbol counts come from the solved puzzle
+        for (int symbol = 0; symbol < 4; symbol++) {
+            symbolCounts[symbol] = 0;
+        }
+        for (size_t k = 0; k < positions.size(); k++) {
+            int symbol = lookupMaps[0][positions[k] / 16];
+            symbolCounts[symbol]++;
+            symbolKinds = max(symbolKinds, symbol + 1);
+        }
+        relabelSymbols = true;
+        for (int symbol = 1; symbol < symbolKinds; symbol++) {
+            relabelSymbols = relabelSymbols && symbolCounts[symbol] == symbolCounts[0];
+        }
+        entries = multinomial(int(positions.size()), symbolCounts) / (relabelSymbols ? factorial(symbolKinds) : 1);
+
+        //the patterns of the solved colorings, where mod 3 lookups stop descending
+        int faceColors[4] = {0, 1, 2, 3};
+        uint8_t pattern[64];
+        do {
+            for (size_t k = 0; k < positions.size(); k++) {
+                pattern[k] = lookupMaps[0][faceColors[positions[k] / 16]];
+            }
+            goalIndices.push_back(rank(pattern));
+        } while (next_permutation(faceColors, faceColors + 4));
+        sort(goalIndices.begin(), goalIndices.end());
+        goalIndices.erase(unique(goalIndices.begin(), goalIndices.end()), goalIndices.end());
+    }
+
+    uint64_t size() const {
+        return entries;
+    }
+
+    int maxValue() const {
+        return maxDepth;
+    }
+
+    //Breadth first search back from every solved coloring, one level at a time. The indices of a
+    //level are handed out to the threads in chunks, and a child is claimed with a compare and
+    //swap on its entry, so every pattern is counted once whatever the thread count. Free moves
+    //are followed first and keep the level's distance, until they reach nothing new.
+    void build(int threads = 1, bool showProgress = false) {
+        encoding = BYTE_ENCODING;
+        table.assign(entries, UNSEEN);
+        uint8_t pattern[64];
+        int faceColors[4] = {0, 1, 2, 3};
+        uint64_t found = 0;
+        do {
+            for (size_t k = 0; k < positions.size(); k++) {
+                pattern[k] = lookupMaps[0][faceColors[positions[k] / 16]];
+            }
+            uint64_t index = rank(pattern);
+            if (table[index] == UNSEEN) {
+                table[index] = 0;
+                found++;
+            }
+        } while (next_permutation(faceColors, faceColors + 4));
+
+        maxDepth = 0;
+        threads = max(threads, 1);
+        uint32_t freeMoves = affectingMoves & ~countedMoves;
+        while (found > 0) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            uint64_t reached = found;
+            while (freeMoves != 0 && reached > 0) {
+                reached = expandLevel(uint8_t(maxDepth), freeMoves, uint8_t(maxDepth), threads);
+                found += reached;
+            }
+            uint64_t frontier = found;
+            found = expandLevel(uint8_t(maxDepth), countedMoves, uint8_t(maxDepth + 1), threads);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (showProgress) {
+                cout << "  " << name << " depth " << maxDepth + 1 << ": " << found << " new patterns, " << seconds << " s, "
+                     << (seconds > 0 ? double(frontier) / seconds : 0.0) << " expanded/s" << endl;
+            }
+            if (found > 0) {
+                maxDepth++;
+            }
+        }
+        data = table.data();
+    }
+
+    //With free moves a start pattern can't find its distance by stepping down one move at a
+    //time, so mod 3 tables are only for databases that count every move, the rest use nibbles
+    PatternEncoding encodingFor(PatternEncoding requested) const {
+        if (requested == MOD3_ENCODING && countedMoves != affectingMoves) {
+            return NIBBLE_ENCODING;
+        }
+        return requested;
+    }
+
+    //repack a built table, this has to happen before it is saved or attached elsewhere
+    void compress(PatternEncoding newEncoding) {
+        newEncoding = encodingFor(newEncoding);
+        if (encoding != BYTE_ENCODING || newEncoding == BYTE_ENCODING) {
+            return;
+        }
+        encoding = newEncoding;
+        vector<uint8_t> packed(tableBytes(), 0);
+        for (uint64_t index = 0; index < entries; index++) {
+            if (encoding == NIBBLE_ENCODING) {
+                packed[index >> 1] |= uint8_t(min(int(table[index]), 15) << ((index & 1) * 4));
+            } else {
+                packed[index >> 2] |= uint8_t((table[index] % 3) << ((index & 3) * 2));
+            }
+        }
+        table.swap(packed);
+        data = table.data();
+    }
+
+    //distance of the pattern that color map c makes of the stickers
+    int lookup(const StickerArray& stickers, int c) const {
+        uint8_t pattern[64];
+        makePattern(stickers, c, pattern);
+        if (encoding == MOD3_ENCODING) {
+            return descendToGoal(pattern);
+        }
+        return storedValue(rank(pattern));
+    }
+
+    //the same for a child whose parent had parentValue with that color map, this is
+    //only a table read for every encoding
+    int lookupChild(const StickerArray& child, int c, int parentValue) const {
+        uint8_t pattern[64];
+        makePattern(child, c, pattern);
+        int stored = storedValue(rank(pattern));
+        if (encoding != MOD3_ENCODING) {
+            return stored;
+        }
+        return parentValue + (stored - parentValue % 3 + 4) % 3 - 1;
+    }
+
+    int lookup(const StickerArray& stickers) const {
+        int value = 0;
+        for (size_t c = 0; c < lookupMaps.size(); c++) {
+            value = max(value, lookup(stickers, int(c)));
+        }
+        return value;
+    }
+
+    //hash of the positions and color map the table was built for, kept in table files
+    uint64_t abstractionHash() const {
+        uint64_t hash = fnv1aHash(positions.data(), positions.size() * sizeof(int));
+        hash = fnv1aHash(&countedMoves, sizeof(countedMoves), hash);
+        return fnv1aHash(lookupMaps[0].data(), lookupMaps[0].size(), hash);
+    }
+
+    const uint8_t* tableData() const {
+        return data;
+    }
+
+    PatternEncoding tableEncoding() const {
+        return encoding;
+    }
+
+    uint64_t tableBytes() const {
+        if (encoding == NIBBLE_ENCODING) {
+            return (entries + 1) / 2;
+        }
+        if (encoding == MOD3_ENCODING) {
+            return (entries + 3) / 4;
+        }
+        return entries;
+    }
+
+    //use a table that lives somewhere else, like a mapped file, instead of building one
+    void attachTable(const uint8_t* tableData, int maxValue, PatternEncoding tableEncoding) {
+        table.clear();
+        data = tableData;
+        maxDepth = maxValue;
+        encoding = tableEncoding;
+    }
+
+private:
+    vector<vector<uint8_t> > localMoves;
+    int symbolCounts[4];
+    int symbolKinds;
+    //patterns are ranked with their symbols renamed in order of first appearance
+    bool relabelSymbols;
+    uint64_t entries;
+    vector<uint64_t> goalIndices;
+    PatternEncoding encoding;
+    //table is only filled when the database was built here, lookups always go through data
+    vector<uint8_t> table;
+    const uint8_t* data;
+    int maxDepth;
+
+    static const uint64_t BUILD_CHUNK = 1 << 16;
+
+    void makePattern(const StickerArray& stickers, int c, uint8_t* pattern) const {
+        for (size_t k = 0; k < positions.size(); k++) {
+            pattern[k] = lookupMaps[c][stickers.sticker[positions[k]]];
+        }
+    }
+
+    int storedValue(uint64_t index) const {
+        if (encoding == NIBBLE_ENCODING) {
+            return (data[index >> 1] >> ((index & 1) * 4)) & 15;
+        }
+        if (encoding == MOD3_ENCODING) {
+            return (data[index >> 2] >> ((index & 3) * 2)) & 3;
+        }
+        return data[index];
+    }
+
+    //Distance of a pattern from mod 3 entries alone: a neighbor one move closer to the goal is
+    //the one whose entry is one less mod 3, so follow those down and count the moves
+    int descendToGoal(const uint8_t* start) const {
+        uint8_t pattern[64];
+        uint8_t child[64];
+        memcpy(pattern, start, positions.size());
+        uint64_t index = rank(pattern);
+        int stored = storedValue(index);
+        int depth = 0;
+        while (!binary_search(goalIndices.begin(), goalIndices.end(), index)) {
+            for (int move = 0; move < 32; move++) {
+                if (!((affectingMoves >> move) & 1)) {
+                    continue;
+                }
+                for (size_t k = 0; k < positions.size(); k++) {
+                    child[k] = pattern[localMoves[move][k]];
+                }
+                uint64_t childIndex = rank(child);
+                if (storedValue(childIndex) == (stored + 2) % 3) {
+                    memcpy(pattern, child, positions.size());
+                    index = childIndex;
+                    stored = (stored + 2) % 3;
+                    depth++;
+                    break;
+                }
+            }
+        }
+        return depth;
+    }
+
+    //expand the patterns at depth with the given moves on every thread, children that were not
+    //seen yet get childDepth, returns how many there were
+    uint64_t expandLevel(uint8_t depth, uint32_t moves, uint8_t childDepth, int threads) {
+        atomic<uint64_t> nextChunk(0);
+        atomic<uint64_t> levelFound(0);
+        vector<thread> workers;
+        for (int t = 1; t < threads; t++) {
+            workers.push_back(thread(&PatternDatabase::expandChunks, this, depth, moves, childDepth, ref(nextChunk),
+                                     ref(levelFound)));
+        }
+        expandChunks(depth, moves, childDepth, nextChunk, levelFound);
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        return levelFound;
+    }
+
+    //one thread's share of a build level: expand the depth entries of the chunks it takes
+    void expandChunks(uint8_t depth, uint32_t moves, uint8_t childDepth, atomic<uint64_t>& nextChunk,
+                      atomic<uint64_t>& levelFound) {
+        uint8_t pattern[64];
+        uint8_t child[64];
+        uint64_t found = 0;
+        uint8_t* entry = table.data();
+        while (true) {
+            uint64_t begin = nextChunk.fetch_add(BUILD_CHUNK);
+            if (begin >= entries) {
+                break;
+            }
+            uint64_t end = min(begin + BUILD_CHUNK, entries);
+            for (uint64_t index = begin; index < end; index++) {
+                if (__atomic_load_n(&entry[index], __ATOMIC_RELAXED) != depth) {
+                    continue;
+                }
+                unrank(index, pattern);
+                for (int move = 0; move < 32; move++) {
+                    if (!((moves >> move) & 1)) {
+                        continue;
+                    }
+                    for (size_t k = 0; k < positions.size(); k++) {
+                        child[k] = pattern[localMoves[move][k]];
+                    }
+                    uint64_t childIndex = rank(child);
+                    uint8_t expected = UNSEEN;
+                    if (__atomic_load_n(&entry[childIndex], __ATOMIC_RELAXED) == UNSEEN &&
+                        __atomic_compare_exchange_n(&entry[childIndex], &expected, childDepth, false,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        found++;
+                    }
+                }
+            }
+        }
+        levelFound += found;
+    }
+
+    //number of ways to arrange the symbols in counts over n positions
+    uint64_t multinomial(int n, const int* counts) const {
+        uint64_t result = 1;
+        for (int symbol = 0; symbol < 4; symbol++) {
+            result *= binomial(n, counts[symbol]);
+            n -= counts[symbol];
+        }
+        return result;
+    }
+
+    static uint64_t factorial(int n) {
+        uint64_t result = 1;
+        for (int i = 2; i <= n; i++) {
+            result *= uint64_t(i);
+        }
+        return result;
+    }
+
+    //Arrangements of the remaining symbols over n positions once used symbols have appeared.
+    //With relabeling the unused symbols still have the same count, and only the arrangements
+    //where they first appear in order are ranked, one in every unused factorial.
+    uint64_t completions(int n, const int* remaining, int used) const {
+        uint64_t count = multinomial(n, remaining);
+        return relabelSymbols ? count / factorial(symbolKinds - used) : count;
+    }
+
+    uint64_t rank(const uint8_t* pattern) const {
+        uint8_t relabeled[64];
+        if (relabelSymbols) {
+            uint8_t newSymbol[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+            uint8_t nextSymbol = 0;
+            for (size_t k = 0; k < positions.size(); k++) {
+                if (newSymbol[pattern[k]] == 0xFF) {
+                    newSymbol[pattern[k]] = nextSymbol++;
+                }
+                relabeled[k] = newSymbol[pattern[k]];
+            }
+            pattern = relabeled;
+        }
+        int remaining[4];
+        memcpy(remaining, symbolCounts, sizeof(remaining));
+        int n = int(positions.size());
+        int used = 0;
+        uint64_t index = 0;
+        for (int k = 0; k < n; k++) {
+            //count the arrangements that put a smaller symbol here
+            for (int symbol = 0; symbol < pattern[k]; symbol++) {
+                if (remaining[symbol] > 0) {
+                    remaining[symbol]--;
+                    index += completions(n - k - 1, remaining, max(used, symbol + 1));
+                    remaining[symbol]++;
+                }
+            }
+            remaining[pattern[k]]--;
+            used = max(used, pattern[k] + 1);
+        }
+        return index;
+    }
+
+    //with relabeling this gives the pattern with its symbols in order of first appearance
+    void unrank(uint64_t index, uint8_t* pattern) const {
+        int remaining[4];
+        memcpy(remaining, symbolCounts, sizeof(remaining));
+        int n = int(positions.size());
+        int used = 0;
+        for (int k = 0; k < n; k++) {
+            int symbolLimit = relabelSymbols ? min(used + 1, symbolKinds) : symbolKinds;
+            for (int symbol = 0; symbol < symbolLimit; symbol++) {
+                if (remaining[symbol] == 0) {
+                    continue;
+                }
+                remaining[symbol]--;
+                uint64_t count = completions(n - k - 1, remaining, max(used, symbol + 1));
+                if (index < count) {
+                    pattern[k] = uint8_t(symbol);
+                    used = max(used, symbol + 1);
+                    break;
+                }
+                index -= count;
+                remaining[symbol]++;
+            }
+        }
+    }
+};
+
+// Pattern databases and the partitions among them whose values add up
+struct PatternDatabaseSet {
+    vector<PatternDatabase*> databases;
+    //indices into databases
+    vector<vector<int> > partitions;
+};
+
+// Heuristic from pattern databases. Databases that count disjoint sets of moves are added up
+// (no single move can count in two of them), and the sums are combined by max with each other
+// and with the sticker heuristic.
+// The cache holds the sticker heuristic's counts, then one byte per database and color map with
+// the distance looked up at that node. A child keeps its parent's distance for every database
+// its move does not change.
+class PatternHeuristic : public Heuristic {
+public:
+    PatternHeuristic() : cacheSlots(StickerHeuristic::CACHE_BYTES), storeCaches(false) {}
+
+    //add to the first group whose databases count none of the same moves, or a new group
+    void addDatabase(const PatternDatabase* database) {
+        int slot = cacheSlot(database);
+        for (size_t g = 0; g < groups.size(); g++) {
+            if ((groupMoves[g] & database->countedMoves) == 0) {
+                groups[g].push_back(database);
+                groupSlots[g].push_back(slot);
+                groupMoves[g] |= database->countedMoves;
+                return;
+            }
+        }
+        groups.push_back(vector<const PatternDatabase*>(1, database));
+        groupSlots.push_back(vector<int>(1, slot));
+        groupMoves.push_back(database->countedMoves);
+    }
+
+    //add the databases of one partition as their own group, they have to count disjoint moves,
+    //and a database may be in several partitions
+    void addPartition(const vector<const PatternDatabase*>& partition) {
+        groups.push_back(partition);
+        groupSlots.push_back(vector<int>());
+        groupMoves.push_back(0);
+        for (size_t d = 0; d < partition.size(); d++) {
+            groupSlots.back().push_back(cacheSlot(partition[d]));
+            groupMoves.back() |= partition[d]->countedMoves;
+        }
+    }
+
+    //every partition of the set, then the databases that are in none
+    void addDatabases(const PatternDatabaseSet& set) {
+        vector<bool> inPartition(set.databases.size(), false);
+        for (size_t p = 0; p < set.partitions.size(); p++) {
+            vector<const PatternDatabase*> partition;
+            for (size_t k = 0; k < set.partitions[p].size(); k++) {
+                partition.push_back(set.databases[set.partitions[p][k]]);
+                inPartition[set.partitions[p][k]] = true;
+            }
+            addPartition(partition);
+        }
+        for (size_t d = 0; d < set.databases.size(); d++) {
+            if (!inPartition[d]) {
+                addDatabase(set.databases[d]);
+            }
+        }
+    }
+
+    int evaluate(const StickerArray& stickers) const {
+        int value = stickerHeuristic.evaluate(stickers);
+        for (size_t g = 0; g < groups.size(); g++) {
+            int sum = 0;
+            for (size_t d = 0; d < groups[g].size(); d++) {
+                sum += groups[g][d]->lookup(stickers);
+            }
+            value = max(value, sum);
+        }
+        return value;
+    }
+
+    bool storeNodeCaches() const {
+        return storeCaches;
+    }
+
+    int evaluateRoot(const StickerArray& stickers, HeuristicCache& cache) const {
+        int value = stickerHeuristic.evaluateRoot(stickers, cache);
+        for (size_t g = 0; g < groups.size(); g++) {
+            int sum = 0;
+            for (size_t d = 0; d < groups[g].size(); d++) {
+                const PatternDatabase* database = groups[g][d];
+                int databaseValue = 0;
+                for (size_t c = 0; c < database->lookupMaps.size(); c++) {
+                    int mapValue = database->lookup(stickers, int(c));
+                    if (groupSlots[g][d] >= 0) {
+                        cache.value[groupSlots[g][d] + c] = uint8_t(mapValue);
+                    }
+                    databaseValue = max(databaseValue, mapValue);
+                }
+                sum += databaseValue;
+            }
+            value = max(value, sum);
+        }
+        return value;
+    }
+
+    int evaluateChild(const StickerArray& child, int move, const HeuristicCache& parentCache, HeuristicCache& cache) const {
+        int value = stickerHeuristic.evaluateChild(child, move, parentCache, cache);
+        for (size_t g = 0; g < groups.size(); g++) {
+            int sum = 0;
+            for (size_t d = 0; d < groups[g].size(); d++) {
+                const PatternDatabase* database = groups[g][d];
+                int slot = groupSlots[g][d];
+                if (slot < 0) {
+                    sum += database->lookup(child);
+                    continue;
+                }
+                bool changed = (database->affectingMoves >> move) & 1;
+                int databaseValue = 0;
+                for (size_t c = 0; c < database->lookupMaps.size(); c++) {
+                    int parentValue = parentCache.value[slot + c];
+                    int mapValue = changed ? database->lookupChild(child, int(c), parentValue) : parentValue;
+                    cache.value[slot + c] = uint8_t(mapValue);
+                    databaseValue = max(databaseValue, mapValue);
+                }
+                sum += databaseValue;
+            }
+            value = max(value, sum);
+        }
+        return value;
+    }
+
+private:
+    vector<vector<const PatternDatabase*> > groups;
+    //first cache byte of each database, or -1 for none
+    vector<vector<int> > groupSlots;
+    vector<uint32_t> groupMoves;
+    vector<pair<const PatternDatabase*, int> > slots;
+    int cacheSlots;
+    bool storeCaches;
+    StickerHeuristic stickerHeuristic;
+
+    //one cache byte per color map, databases past the cache size are looked up in full
+    int cacheSlot(const PatternDatabase* database) {
+        for (size_t k = 0; k < slots.size(); k++) {
+            if (slots[k].first == database) {
+                return slots[k].second;
+            }
+        }
+        int slot = -1;
+        if (cacheSlots + int(database->lookupMaps.size()) <= HEURISTIC_CACHE_SIZE) {
+            slot = cacheSlots;
+            cacheSlots += int(database->lookupMaps.size());
+            //mod 3 distances can only be followed from the parent's
+            storeCaches = storeCaches || database->tableEncoding() == MOD3_ENCODING;
+        }
+        slots.push_back(make_pair(database, slot));
+        return slot;
+    }
+};
+
+ColorMap identityColorMap() {
+    ColorMap colorMap = {{0, 1, 2, 3}};
+    return colorMap;
+}
+
+//Add the databases for a partition of sticker locations, one per cell, whose values can be
+//added up. Each layer is charged to the first cell its moves change and is free in the other
+//cells, so no move of a solution is counted by two of them. Databases the set already has
+//are shared instead of built twice.
+void addPartitionDatabases(PatternDatabaseSet& set, const vector<string>& names, const vector<vector<int> >& cells,
+                           const vector<vector<ColorMap> >& colorMaps) {
+    vector<uint32_t> charged(cells.size(), 0);
+    for (int move = 0; move < 32; move += 2) {
+        for (size_t c = 0; c < cells.size(); c++) {
+            bool changes = false;
+            for (size_t k = 0; k < cells[c].size() && !changes; k++) {
+                changes = moveTable[move][cells[c][k]] != cells[c][k];
+            }
+            if (changes) {
+                charged[c] |= 3u << move;
+                break;
+            }
+        }
+    }
+    vector<int> partition;
+    for (size_t c = 0; c < cells.size(); c++) {
+        PatternDatabase* database = new PatternDatabase(names[c], cells[c], colorMaps[c], charged[c]);
+        int index = -1;
+        for (size_t d = 0; d < set.databases.size() && index < 0; d++) {
+            if (set.databases[d]->abstractionHash() == database->abstractionHash() && set.databases[d]->size() == database->size()) {
+                index = int(d);
+            }
+        }
+        if (index < 0) {
+            set.databases.push_back(database);
+            index = int(set.databases.size() - 1);
+        } else {
+            delete database;
+        }
+        partition.push_back(index);
+    }
+    set.partitions.push_back(partition);
+}
+
+//Databases for the 12 tip stickers and the 12 center triangles around the middle of each face,
+//and with includeEdges the 36 edge stickers with one color against the rest (94 million
+//patterns, one table serves all four colors). The single middle triangle of each face gets no
+//table of its own: any arrangement of those four is a coloring of a solved puzzle.
+//With additive, tips, centers and (with includeEdges) edges also form a partition: tips pay
+//for the tip and fourth row moves, centers for the third rows and edges for the second rows.
+//Charging the fourth rows to the centers instead leaves the tips with only free moves, which
+//can reach every tip pattern, so that partition is no better than the centers table alone.
+PatternDatabaseSet createPatternDatabases(bool includeEdges, bool additive) {
+    PatternDatabaseSet set;
+    vector<ColorMap> allColors(1, identityColorMap());
+    vector<ColorMap> oneColor;
+    for (int color = 0; color < 4; color++) {
+        ColorMap colorMap = {{0, 0, 0, 0}};
+        colorMap[color] = 1;
+        oneColor.push_back(colorMap);
+    }
+    vector<int> tips = stickerOrbit(stickerIndex(FRONT, 0, 0));
+    vector<int> centers = stickerOrbit(stickerIndex(FRONT, 2, 1));
+    vector<int> edges = stickerOrbit(stickerIndex(FRONT, 1, 0));
+    set.databases.push_back(new PatternDatabase("tips", tips, allColors));
+    set.databases.push_back(new PatternDatabase("centers", centers, allColors));
+    if (includeEdges) {
+        set.databases.push_back(new PatternDatabase("edges", edges, oneColor));
+    }
+    if (additive) {
+        vector<string> names;
+        vector<vector<int> > cells;
+        vector<vector<ColorMap> > colorMaps;
+        names.push_back("tips");
+        cells.push_back(tips);
+        colorMaps.push_back(allColors);
+        names.push_back("centers-third-rows");
+        cells.push_back(centers);
+        colorMaps.push_back(allColors);
+        if (includeEdges) {
+            names.push_back("edges-second-rows");
+            cells.push_back(edges);
+            colorMaps.push_back(oneColor);
+        }
+        addPartitionDatabases(set, names, cells, colorMaps);
+    }
+    return set;
+}
+
+void buildDatabases(const vector<PatternDatabase*>& databases, int threads, PatternEncoding encoding) {
+    for (size_t d = 0; d < databases.size(); d++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        databases[d]->build(threads, true);
+        databases[d]->compress(encoding);
+        cout << "Pattern database " << databases[d]->name << ": " << databases[d]->size() << " patterns, max "
+             << databases[d]->maxValue() << " moves, " << databases[d]->tableBytes() << " bytes, "
+             << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+    }
+}
+
+PatternDatabaseSet buildPatternDatabases(bool includeEdges, bool additive, int threads, PatternEncoding encoding) {
+    PatternDatabaseSet set = createPatternDatabases(includeEdges, additive);
+    buildDatabases(set.databases, threads, encoding);
+    return set;
+}
+
+// Table file: a header, a directory with one entry per table, then the tables. Each table starts
+// on a page boundary, so the file can be mapped read only and used in place. Every process that
+// maps the same file shares its pages through the page cache.
+const char PATTERN_FILE_MAGIC[8] = {'P', 'Y', 'R', 'A', 'P', 'D', 'B', 0};
+const uint32_t PATTERN_FILE_VERSION = 1;
+const uint64_t PATTERN_FILE_ALIGNMENT = 4096;
+
+struct PatternFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tableCount;
+    //hash of the move tables the file was built from
+    uint64_t layoutHash;
+    uint64_t fileSize;
+    //checksum of the directory, the table data has its own checksums
+    uint64_t directoryChecksum;
+};
+
+struct PatternFileEntry {
+    char name[32];
+    //positions and color map of the abstraction
+    uint64_t abstractionHash;
+    uint64_t entries;
+    uint64_t offset;
+    uint64_t bytes;
+    uint32_t maxValue;
+    //a PatternEncoding
+    uint32_t encoding;
+    //only checked on request, since that reads every page
+    uint64_t checksum;
+};
+
+// A table file mapped read only
+class PatternFile {
+public:
+    PatternFile() : mapping(NULL), mappingSize(0) {}
+
+    ~PatternFile() {
+        close();
+    }
+
+    //map the file and check the header, with verifyData every table checksum is checked too
+    bool open(const string& path, bool verifyData) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(PatternFileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        mapping = (const uint8_t*)mapped;
+        mappingSize = size_t(info.st_size);
+        if (!checkLayout(verifyData)) {
+            close();
+            return false;
+        }
+        return true;
+#else
+        (void)path;
+        (void)verifyData;
+        return false;
+#endif
+    }
+
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapping != NULL) {
+            munmap((void*)mapping, mappingSize);
+        }
+#endif
+        mapping = NULL;
+        mappingSize = 0;
+    }
+
+    //find a table by name, it has to match the abstraction it was built for and the encoding
+    const PatternFileEntry* findTable(const string& name, uint64_t abstractionHash, uint64_t entries,
+                                      PatternEncoding encoding) const {
+        const PatternFileEntry* entry = findTable(name, abstractionHash, encoding);
+        return entry != NULL && entry->entries == entries ? entry : NULL;
+    }
+
+    //the same for tables whose size is only known once they are built
+    const PatternFileEntry* findTable(const string& name, uint64_t abstractionHash, PatternEncoding encoding) const {
+        if (mapping == NULL) {
+            return NULL;
+        }
+        const PatternFileHeader* header = (const PatternFileHeader*)mapping;
+        const PatternFileEntry* directory = (const PatternFileEntry*)(mapping + sizeof(PatternFileHeader));
+        for (uint32_t t = 0; t < header->tableCount; t++) {
+            if (name == directory[t].name && directory[t].abstractionHash == abstractionHash &&
+                directory[t].encoding == uint32_t(encoding)) {
+                return &directory[t];
+            }
+        }
+        return NULL;
+    }
+
+    const uint8_t* tableData(const PatternFileEntry* entry) const {
+        return mapping + entry->offset;
+    }
+
+    //write tables into a new file, returns false if the file could not be written. Table is
+    //PatternDatabase or anything else with its name, size, maxValue and table accessors.
+    template <class Table>
+    static bool write(const string& path, const vector<const Table*>& databases) {
+        vector<PatternFileEntry> directory(databases.size());
+        uint64_t offset = alignUp(sizeof(PatternFileHeader) + directory.size() * sizeof(PatternFileEntry));
+        for (size_t d = 0; d < databases.size(); d++) {
+            PatternFileEntry& entry = directory[d];
+            memset(&entry, 0, sizeof(entry));
+            strncpy(entry.name, databases[d]->name.c_str(), sizeof(entry.name) - 1);
+            entry.abstractionHash = databases[d]->abstractionHash();
+            entry.entries = databases[d]->size();
+            entry.offset = offset;
+            entry.bytes = databases[d]->tableBytes();
+            entry.maxValue = uint32_t(databases[d]->maxValue());
+            entry.encoding = uint32_t(databases[d]->tableEncoding());
+            entry.checksum = fnv1aHash(databases[d]->tableData(), size_t(entry.bytes));
+            offset = alignUp(offset + entry.bytes);
+        }
+        PatternFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PATTERN_FILE_MAGIC, sizeof(header.magic));
+        header.version = PATTERN_FILE_VERSION;
+        header.tableCount = uint32_t(directory.size());
+        header.layoutHash = puzzleLayoutHash();
+        header.fileSize = offset;
+        header.directoryChecksum = fnv1aHash(directory.data(), directory.size() * sizeof(PatternFileEntry));
+
+        //write to a temporary name first so readers never map a half written file, one name per
+        //process so processes building the same file at once don't write into each other's
+#if defined(__unix__) || defined(__APPLE__)
+        string temporaryPath = path + "." + to_string(getpid()) + ".tmp";
+#else
+        string temporaryPath = path + ".tmp";
+#endif
+        ofstream file(temporaryPath.c_str(), ios::binary | ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)directory.data(), directory.size() * sizeof(PatternFileEntry));
+        uint64_t written = sizeof(header) + directory.size() * sizeof(PatternFileEntry);
+        for (size_t d = 0; d < databases.size(); d++) {
+            writePadding(file, directory[d].offset - written);
+            file.write((const char*)databases[d]->tableData(), directory[d].bytes);
+            written = directory[d].offset + directory[d].bytes;
+        }
+        writePadding(file, header.fileSize - written);
+        file.close();
+        if (!file) {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    const uint8_t* mapping;
+    size_t mappingSize;
+
+    static uint64_t alignUp(uint64_t offset) {
+        return (offset + PATTERN_FILE_ALIGNMENT - 1) / PATTERN_FILE_ALIGNMENT * PATTERN_FILE_ALIGNMENT;
+    }
+
+    static void writePadding(ofstream& file, uint64_t bytes) {
+        static const char zeros[PATTERN_FILE_ALIGNMENT] = {0};
+        while (bytes > 0) {
+            uint64_t chunk = min(bytes, PATTERN_FILE_ALIGNMENT);
+            file.write(zeros, chunk);
+            bytes -= chunk;
+        }
+    }
+
+    bool checkLayout(bool verifyData) const {
+        const PatternFileHeader* header = (const PatternFileHeader*)mapping;
+        if (memcmp(header->magic, PATTERN_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != PATTERN_FILE_VERSION || header->layoutHash != puzzleLayoutHash() ||
+            header->fileSize != mappingSize ||
+            sizeof(PatternFileHeader) + uint64_t(header->tableCount) * sizeof(PatternFileEntry) > mappingSize) {
+            return false;
+        }
+        const PatternFileEntry* directory = (const PatternFileEntry*)(mapping + sizeof(PatternFileHeader));
+        if (fnv1aHash(directory, header->tableCount * sizeof(PatternFileEntry)) != header->directoryChecksum) {
+            return false;
+        }
+        for (uint32_t t = 0; t < header->tableCount; t++) {
+            if (directory[t].offset % PATTERN_FILE_ALIGNMENT != 0 || directory[t].offset + directory[t].bytes > mappingSize) {
+                return false;
+            }
+            if (verifyData && fnv1aHash(mapping + directory[t].offset, size_t(directory[t].bytes)) != directory[t].checksum) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//Use the tables in the file when it has all of them, otherwise build them and write the file.
+//The returned databases point into file, so it has to stay open while they are used.
+PatternDatabaseSet loadPatternDatabases(const string& path, bool includeEdges, bool additive, bool verifyData, int threads,
+                                        PatternEncoding encoding, PatternFile& file) {
+    PatternDatabaseSet set = createPatternDatabases(includeEdges, additive);
+    vector<PatternDatabase*>& databases = set.databases;
+    if (file.open(path, verifyData)) {
+        bool complete = true;
+        for (size_t d = 0; d < databases.size() && complete; d++) {
+            PatternEncoding tableEncoding = databases[d]->encodingFor(encoding);
+            const PatternFileEntry* entry = file.findTable(databases[d]->name, databases[d]->abstractionHash(),
+                                                           databases[d]->size(), tableEncoding);
+            if (entry == NULL) {
+                complete = false;
+            } else {
+                databases[d]->attachTable(file.tableData(entry), int(entry->maxValue), tableEncoding);
+            }
+        }
+        if (complete) {
+            cout << "Pattern databases mapped from " << path << endl;
+            return set;
+        }
+        file.close();
+    }
+    buildDatabases(databases, threads, encoding);
+    vector<const PatternDatabase*> built(databases.begin(), databases.end());
+    if (PatternFile::write(path, built)) {
+        cout << "Pattern databases written to " << path << endl;
+    } else {
+        cout << "Could not write " << path << endl;
+    }
+    return set;
+}
+
+// Open addressing hash map from packed states to a byte (a move count) with linear probing.
+// Nothing is ever removed, so inserts never leave tombstones. An empty slot holds the state
+// with every bit set (all blue), and that one key is kept in its own fields instead of a slot.
+class PackedStateMap {
+public:
+    explicit PackedStateMap(double maxLoadFactor = 0.7, size_t initialCapacity = 1024)
+        : count(0), maxLoad(maxLoadFactor), hasEmptyKey(false), emptyKeyValue(0) {
+        size_t capacity = 16;
+        while (capacity < initialCapacity) {
+            capacity *= 2;
+        }
+        keys.assign(capacity, emptyKey());
+        values.assign(capacity, 0);
+        mask = capacity - 1;
+    }
+
+    //pointer to the value stored for the state, or null if it is not in the map
+    uint8_t* find(const PackedPyraminx& state) {
+        if (state == emptyKey()) {
+            return hasEmptyKey ? &emptyKeyValue : NULL;
+        }
+        size_t slot = PackedPyraminxHash()(state) & mask;
+        while (keys[slot] != emptyKey()) {
+            if (keys[slot] == state) {
+                return &values[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return NULL;
+    }
+
+    bool contains(const PackedPyraminx& state) {
+        return find(state) != NULL;
+    }
+
+    //store the value for the state, returns true if the state was not in the map yet
+    bool insert(const PackedPyraminx& state, uint8_t value) {
+        if (state == emptyKey()) {
+            bool added = !hasEmptyKey;
+            hasEmptyKey = true;
+            emptyKeyValue = value;
+            return added;
+        }
+        if (double(count + 1) > maxLoad * double(keys.size())) {
+            grow();
+        }
+        size_t slot = PackedPyraminxHash()(state) & mask;
+        while (keys[slot] != emptyKey()) {
+            if (keys[slot] == state) {
+                values[slot] = value;
+                return false;
+            }
+            slot = (slot + 1) & mask;
+        }
+        keys[slot] = state;
+        values[slot] = value;
+        count++;
+        return true;
+    }
+
+    size_t size() const {
+        return count + (hasEmptyKey ? 1 : 0);
+    }
+
+    size_t memoryUsage() const {
+        return keys.size() * (sizeof(PackedPyraminx) + 1);
+    }
+
+private:
+    vector<PackedPyraminx> keys;
+    vector<uint8_t> values;
+    size_t count;
+    size_t mask;
+    double maxLoad;
+    bool hasEmptyKey;
+    uint8_t emptyKeyValue;
+
+    static PackedPyraminx emptyKey() {
+        PackedPyraminx key;
+        key.lo = ~uint64_t(0);
+        key.hi = ~uint64_t(0);
+        return key;
+    }
+
+    //double the table and insert everything again
+    void grow() {
+        vector<PackedPyraminx> oldKeys;
+        vector<uint8_t> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        keys.assign(oldKeys.size() * 2, emptyKey());
+        values.assign(oldKeys.size() * 2, 0);
+        mask = keys.size() - 1;
+        for (size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i] != emptyKey()) {
+                size_t slot = PackedPyraminxHash()(oldKeys[i]) & mask;
+                while (keys[slot] != emptyKey()) {
+                    slot = (slot + 1) & mask;
+                }
+                keys[slot] = oldKeys[i];
+                values[slot] = oldValues[i];
+            }
+        }
+    }
+};
+
+//Proof by enumeration that a heuristic never overestimates near the goal: breadth first search
+//from every solved coloring up to maxDepth moves, comparing h with the exact distance of every
+//state reached. Prints the first state it finds overestimated.
+bool verifyHeuristic(const Heuristic& heuristic, int maxDepth) {
+    Pyraminx solvedPyraminx;
+    PackedPyraminx solvedPacked(solvedPyraminx);
+    StickerArray solved(solvedPacked);
+    PackedStateMap distance;
+    vector<PackedPyraminx> level;
+    uint8_t faceColors[4] = {0, 1, 2, 3};
+    do {
+        StickerArray coloring = solved;
+        for (int i = 0; i < 64; i++) {
+            coloring.sticker[i] = faceColors[solved.sticker[i]];
+        }
+        if (distance.insert(coloring.pack(), 0)) {
+            level.push_back(coloring.pack());
+        }
+    } while (next_permutation(faceColors, faceColors + 4));
+
+    int worstGap = INT_MAX;
+    for (int depth = 0; depth <= maxDepth; depth++) {
+        long long total = 0;
+        for (size_t k = 0; k < level.size(); k++) {
+            StickerArray stickers(level[k]);
+            int h = heuristic.evaluate(stickers);
+            if (h > depth) {
+                cout << "Heuristic " << h << " at distance " << depth << ":" << endl;
+                level[k].unpack().printPyraminx();
+                return false;
+            }
+            worstGap = min(worstGap, depth - h);
+            total += h;
+        }
+        cout << "Distance " << depth << ": " << level.size() << " states, average h "
+             << (level.empty() ? 0.0 : double(total) / level.size()) << endl;
+        if (depth == maxDepth) {
+            break;
+        }
+        vector<PackedPyraminx> next;
+        for (size_t k = 0; k < level.size(); k++) {
+            for (int move = 0; move < 32; move++) {
+                PackedPyraminx child = level[k];
+                child.applyMove(move);
+                if (distance.insert(child, uint8_t(depth + 1))) {
+                    next.push_back(child);
+                }
+            }
+        }
+        level.swap(next);
+    }
+    cout << "Never overestimates up to distance " << maxDepth << ", tightest gap " << worstGap << endl;
+    return true;
+}
+
+// Every state within depth moves of solved, with its exact distance. States are keyed with their
+// colors renamed in order of first appearance, so the 24 solved colorings are one start. The
+// table is open addressing with linear probing on PackedPyraminxHash: capacity keys, then one
+// distance byte per slot. That is also how it is stored in a table file and used in place.
+// Empty slots hold the all ones key, which is never a renamed state (its first color is 3).
+class PerimeterTable {
+public:
+    string name;
+
+    PerimeterTable() : name("perimeter"), depth(-1), capacity(0), keys(NULL), distances(NULL) {}
+
+    //breadth first search out to maxDepth moves, then lay the states out as the flat table
+    void build(int maxDepth) {
+        Pyraminx solvedPyraminx;
+        PackedPyraminx solvedPacked(solvedPyraminx);
+        StickerArray solved(solvedPacked);
+        SymmetryGroup::relabel(solved);
+        PackedStateMap found;
+        vector<PackedPyraminx> level(1, solved.pack());
+        vector<PackedPyraminx> states(level);
+        found.insert(level[0], 0);
+        for (int d = 1; d <= maxDepth; d++) {
+            vector<PackedPyraminx> next;
+            for (size_t k = 0; k < level.size(); k++) {
+                StickerArray stickers(level[k]);
+                for (int move = 0; move < 32; move++) {
+                    StickerArray child = stickers;
+                    child.applyMove(move);
+                    SymmetryGroup::relabel(child);
+                    if (!found.contains(child.pack())) {
+                        found.insert(child.pack(), uint8_t(d));
+                        next.push_back(child.pack());
+                    }
+                }
+            }
+            level.swap(next);
+            states.insert(states.end(), level.begin(), level.end());
+        }
+
+        //at most half full, so misses end after a short probe
+        uint64_t slots = 16;
+        while (slots < 2 * states.size()) {
+            slots *= 2;
+        }
+        table.assign(slots * (sizeof(PackedPyraminx) + 1), 0);
+        attachTable(table.data(), maxDepth, slots);
+        PackedPyraminx* slotKeys = (PackedPyraminx*)table.data();
+        uint8_t* slotDistances = table.data() + slots * sizeof(PackedPyraminx);
+        for (uint64_t slot = 0; slot < slots; slot++) {
+            slotKeys[slot] = emptyKey();
+        }
+        for (size_t k = 0; k < states.size(); k++) {
+            uint64_t slot = PackedPyraminxHash()(states[k]) & (slots - 1);
+            while (slotKeys[slot] != emptyKey()) {
+                slot = (slot + 1) & (slots - 1);
+            }
+            slotKeys[slot] = states[k];
+            slotDistances[slot] = *found.find(states[k]);
+        }
+    }
+
+    //use a table that lives somewhere else, like a mapped file, slots has to be a power of two
+    void attachTable(const uint8_t* tableData, int maxDepth, uint64_t slots) {
+        if (tableData != table.data()) {
+            table.clear();
+        }
+        depth = maxDepth;
+        capacity = slots;
+        keys = (const PackedPyraminx*)tableData;
+        distances = tableData + slots * sizeof(PackedPyraminx);
+    }
+
+    //moves from the state to solved, or -1 when it is more than depth moves away
+    int distance(const StickerArray& stickers) const {
+        StickerArray key = stickers;
+        SymmetryGroup::relabel(key);
+        PackedPyraminx packed = key.pack();
+        uint64_t slot = PackedPyraminxHash()(packed) & (capacity - 1);
+        while (keys[slot] != emptyKey()) {
+            if (keys[slot] == packed) {
+                return distances[slot];
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+        return -1;
+    }
+
+    //append the moves from a state in the table to solved, each one to a state one move closer
+    void appendSolution(const StickerArray& stickers, vector<int>& moves) const {
+        StickerArray current = stickers;
+        int left = distance(current);
+        while (left > 0) {
+            for (int move = 0; move < 32; move++) {
+                StickerArray next = current;
+                next.applyMove(move);
+                if (distance(next) == left - 1) {
+                    moves.push_back(move);
+                    current = next;
+                    left--;
+                    break;
+                }
+            }
+        }
+    }
+
+    int maxValue() const {
+        return depth;
+    }
+
+    uint64_t size() const {
+        return capacity;
+    }
+
+    uint64_t tableBytes() const {
+        return capacity * (sizeof(PackedPyraminx) + 1);
+    }
+
+    const uint8_t* tableData() const {
+        return (const uint8_t*)keys;
+    }
+
+    PatternEncoding tableEncoding() const {
+        return BYTE_ENCODING;
+    }
+
+    //tables for another depth or another hash function are not used
+    uint64_t abstractionHash() const {
+        return abstractionHash(depth);
+    }
+
+    static uint64_t abstractionHash(int maxDepth) {
+        PackedPyraminx probe;
+        probe.lo = 0x0123456789ABCDEFull;
+        probe.hi = 0xFEDCBA9876543210ull;
+        uint64_t probeHash = PackedPyraminxHash()(probe);
+        uint64_t hash = fnv1aHash(&maxDepth, sizeof(maxDepth));
+        return fnv1aHash(&probeHash, sizeof(probeHash), hash);
+    }
+
+private:
+    int depth;
+    uint64_t capacity;
+    //table is only filled when the table was built here, lookups always go through keys
+    vector<uint8_t> table;
+    const PackedPyraminx* keys;
+    const uint8_t* distances;
+
+    static PackedPyraminx emptyKey() {
+        PackedPyraminx key;
+        key.lo = ~uint64_t(0);
+        key.hi = ~uint64_t(0);
+        return key;
+    }
+};
+
+// Perimeter search bound: the exact distance for states in the perimeter table, and for the
+// rest the larger of the inner heuristic and one more than the table's depth, since anything
+// nearer would be in the table. The cache is the inner heuristic's.
+class PerimeterHeuristic : public Heuristic {
+public:
+    PerimeterHeuristic(const Heuristic& innerHeuristic, const PerimeterTable& perimeterTable)
+        : inner(innerHeuristic), perimeter(perimeterTable) {}
+
+    int evaluate(const StickerArray& stickers) const {
+        return sharpen(stickers, inner.evaluate(stickers));
+    }
+
+    bool storeNodeCaches() const {
+        return inner.storeNodeCaches();
+    }
+
+    int evaluateRoot(const StickerArray& stickers, HeuristicCache& cache) const {
+        return sharpen(stickers, inner.evaluateRoot(stickers, cache));
+    }
+
+    int evaluateChild(const StickerArray& child, int move, const HeuristicCache& parentCache, HeuristicCache& cache) const {
+        return sharpen(child, inner.evaluateChild(child, move, parentCache, cache));
+    }
+
+private:
+    const Heuristic& inner;
+    const PerimeterTable& perimeter;
+
+    int sharpen(const StickerArray& stickers, int value) const {
+        int exact = perimeter.distance(stickers);
+        return exact >= 0 ? exact : max(value, perimeter.maxValue() + 1);
+    }
+};
+
+//Map the perimeter table from the file when it has one for this depth, otherwise build it and
+//write the file. The table points into file, so it has to stay open while the table is used.
+void loadPerimeterTable(const string& path, int depth, bool verifyData, PerimeterTable& perimeter, PatternFile& file) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!path.empty() && file.open(path, verifyData)) {
+        const PatternFileEntry* entry = file.findTable(perimeter.name, PerimeterTable::abstractionHash(depth), BYTE_ENCODING);
+        uint64_t slots = entry != NULL ? entry->entries : 0;
+        if (slots != 0 && (slots & (slots - 1)) == 0 && entry->bytes == slots * (sizeof(PackedPyraminx) + 1)) {
+            perimeter.attachTable(file.tableData(entry), int(entry->maxValue), slots);
+            cout << "Perimeter table mapped from " << path << endl;
+            return;
+        }
+        file.close();
+    }
+    perimeter.build(depth);
+    cout << "Perimeter table: every state within " << depth << " moves, " << perimeter.size() << " slots, "
+         << perimeter.tableBytes() << " bytes, " << chrono::duration<double>(chrono::steady_clock::now() - start).count()
+         << " s" << endl;
+    if (path.empty()) {
+        return;
+    }
+    if (PatternFile::write(path, vector<const PerimeterTable*>(1, &perimeter))) {
+        cout << "Perimeter table written to " << path << endl;
+    } else {
+        cout << "Could not write " << path << endl;
+    }
+}
+
+// A* search node, kept in one contiguous arena and linked to its parent by index
+struct SearchNode {
+    PackedPyraminx state;
+    uint32_t parent;
+    uint8_t move;
+    uint8_t g;
+};
+
+const uint32_t NO_PARENT = UINT32_MAX;
+
+// Open list for the small integer f values of A*: one bucket per f, and inside it one
+// bucket per h so ties go to the node closest to the goal. It only holds arena indices,
+// push is O(1) and pop is O(1) apart from moving past buckets that ran empty.
+class BucketQueue {
+public:
+    BucketQueue() : count(0), minF(0) {}
+
+    void push(uint32_t node, int f, int h) {
+        if (f >= int(buckets.size())) {
+            buckets.resize(f + 1);
+        }
+        if (h >= int(buckets[f].size())) {
+            buckets[f].resize(h + 1);
+        }
+        buckets[f][h].push_back(node);
+        if (count == 0 || f < minF) {
+            minF = f;
+        }
+        count++;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    //f of the next node pop() returns, the queue must not be empty
+    int topF() {
+        skipEmptyBuckets();
+        return minF;
+    }
+
+    //remove the node with the lowest f, and the lowest h among those
+    uint32_t pop() {
+        skipEmptyBuckets();
+        vector<vector<uint32_t> >& bucket = buckets[minF];
+        for (size_t h = 0; h < bucket.size(); h++) {
+            if (!bucket[h].empty()) {
+                uint32_t node = bucket[h].back();
+                bucket[h].pop_back();
+                count--;
+                return node;
+            }
+        }
+        return NO_NODE;
+    }
+
+    static const uint32_t NO_NODE = UINT32_MAX;
+
+private:
+    vector<vector<vector<uint32_t> > > buckets;
+    size_t count;
+    int minF;
+
+    void skipEmptyBuckets() {
+        while (minF < int(buckets.size())) {
+            vector<vector<uint32_t> >& bucket = buckets[minF];
+            for (size_t h = 0; h < bucket.size(); h++) {
+                if (!bucket[h].empty()) {
+                    return;
+                }
+            }
+            minF++;
+        }
+    }
+};
+
+//follow the parent links back to the start and return the moves in order
+vector<int> reconstructPath(const vector<SearchNode>& arena, uint32_t node) {
+    vector<int> moves;
+    while (arena[node].parent != NO_PARENT) {
+        moves.push_back(arena[node].move);
+        node = arena[node].parent;
+    }
+    reverse(moves.begin(), moves.end());
+    return moves;
+}
+
+//A* algorithm, returns the moves that solve the pyraminx
+//With a perimeter table the search stops at the first node it pops from inside the perimeter
+//whose g plus exact distance is no more than the lowest f, which makes the solution optimal.
+vector<int> aStarSolve(Pyraminx& initialPyraminx, const Heuristic& heuristic, const PerimeterTable* perimeter = NULL) {
+    BucketQueue openList;
+    //best g found so far for every generated state
+    PackedStateMap bestG;
+    vector<SearchNode> arena;
+    //heuristic caches of the arena nodes, only kept when the heuristic cannot rebuild them
+    vector<HeuristicCache> caches;
+    bool keepCaches = heuristic.storeNodeCaches();
+    HeuristicCache nodeCache;
+    HeuristicCache childCache;
+    //track nodes expanded
+    int nodesExpanded = 0;
+
+    //initial pyraminx is the initial state of the pyraminx
+    PackedPyraminx initialPacked(initialPyraminx);
+    StickerArray initialStickers(initialPacked);
+    SearchNode initialNode = {initialPacked, NO_PARENT, 0, 0};
+    arena.push_back(initialNode);
+    bestG.insert(symmetryGroup.canonicalize(initialStickers), 0);
+    int initialH = heuristic.evaluateRoot(initialStickers, nodeCache);
+    if (keepCaches) {
+        caches.push_back(nodeCache);
+    }
+    openList.push(0, initialH, initialH);
+
+    while(!openList.empty()) {
+        //update for current state
+        int lowestF = openList.topF();
+        uint32_t current = openList.pop();
+        SearchNode node = arena[current];
+        StickerArray stickers(node.state);
+        //skip nodes that were reached again with a smaller g after being pushed
+        if (node.g > *bestG.find(symmetryGroup.canonicalize(stickers))) {
+            continue;
+        }
+        nodesExpanded++;
+        int perimeterDistance = perimeter != NULL ? perimeter->distance(stickers) : -1;
+        if (perimeterDistance >= 0 && node.g + perimeterDistance <= lowestF) {
+            vector<int> moves = reconstructPath(arena, current);
+            size_t searched = moves.size();
+            perimeter->appendSolution(stickers, moves);
+            for (size_t k = searched; k < moves.size(); k++) {
+                stickers.applyMove(moves[k]);
+            }
+            cout << "Solution found in " << moves.size() << " moves!" << endl;
+            stickers.pack().unpack().printPyraminx();
+            //cout << "Nodes Expanded: " << nodesExpanded << endl;
+            return moves;
+        }
+        if(node.state.isSolved()) {
+            cout << "Solution found in " << int(node.g) << " moves!" << endl;
+            node.state.unpack().printPyraminx();
+            //Un-comment this line to show how many nodes are expanded for each pyramid
+            //cout << "Nodes Expanded: " << nodesExpanded << endl;
+            return reconstructPath(arena, current);
+        }
+
+        //The full canonical automaton is not safe together with duplicate detection: the
+        //node kept for a state may end in a different move than the canonical path that
+        //continues from it. Dropping turns of the last layer is always safe, and the best g
+        //table already removes the sequences that only differ in order.
+        int lastMove = node.parent == NO_PARENT ? MoveAutomaton::START : node.move;
+        uint32_t allowedMoves = moveAutomaton.nonRedundant[lastMove];
+        if (keepCaches) {
+            nodeCache = caches[current];
+        } else {
+            heuristic.evaluateRoot(stickers, nodeCache);
+        }
+        for (int i = 0; i < 32; i++) {
+            if (!((allowedMoves >> i) & 1)) {
+                continue;
+            }
+            //try each move and update into a new node
+            StickerArray next = stickers;
+            next.applyMove(i);
+            int newG = node.g + 1;
+            //only push states that are new or reached with a smaller g, which also re-opens them,
+            //symmetric states share one entry
+            PackedPyraminx nextKey = symmetryGroup.canonicalize(next);
+            uint8_t* knownG = bestG.find(nextKey);
+            if (knownG != NULL && *knownG <= newG) {
+                continue;
+            }
+            bestG.insert(nextKey, uint8_t(newG));
+            int newH = heuristic.evaluateChild(next, i, nodeCache, childCache);
+
+            SearchNode newNode = {next.pack(), current, uint8_t(i), uint8_t(newG)};
+            arena.push_back(newNode);
+            if (keepCaches) {
+                caches.push_back(childCache);
+            }
+            openList.push(uint32_t(arena.size() - 1), newG + newH, newH);
+        }
+    }
+
+    //if no solution is found
+    cout << "No solution found!" << endl;
+    return vector<int>();
+};
+
+// Lower bound on the moves between a state and one fixed target coloring, with colors renamed
+// freely. A sticker that differs from the target has to be moved at least once, and every orbit
+// keeps its stickers, so an orbit with d mismatched stickers needs d / carried moves, where
+// carried is the most stickers of the orbit one move shifts. Used by bidirectional search to
+// aim the backward side at the scrambled state.
+class StickerDistanceBound {
+public:
+    explicit StickerDistanceBound(const StickerArray& targetStickers) : target(targetStickers) {
+        vector<vector<int> > orbits = findStickerOrbits();
+        orbitCount = int(orbits.size());
+        for (int k = 0; k < orbitCount; k++) {
+            carried[k] = 0;
+            for (int move = 0; move < 32; move++) {
+                int moved = 0;
+                for (size_t s = 0; s < orbits[k].size(); s++) {
+                    moved += moveTable[move][orbits[k][s]] != orbits[k][s];
+                }
+                carried[k] = max(carried[k], moved);
+            }
+            for (size_t s = 0; s < orbits[k].size(); s++) {
+                stickerOrbitIndex[orbits[k][s]] = uint8_t(k);
+            }
+        }
+        uint8_t colors[4] = {0, 1, 2, 3};
+        int p = 0;
+        do {
+            memcpy(renaming[p++], colors, 4);
+        } while (next_permutation(colors, colors + 4));
+    }
+
+    int evaluate(const StickerArray& stickers) const {
+        //same[k][a][b]: stickers of orbit k that are a here and b in the target
+        int same[64][4][4];
+        memset(same, 0, sizeof(int) * 16 * orbitCount);
+        int orbitSize[64];
+        memset(orbitSize, 0, sizeof(int) * orbitCount);
+        for (int i = 0; i < 64; i++) {
+            same[stickerOrbitIndex[i]][stickers.sticker[i]][target.sticker[i]]++;
+            orbitSize[stickerOrbitIndex[i]]++;
+        }
+        int best = INT_MAX;
+        for (int p = 0; p < 24 && best > 0; p++) {
+            int bound = 0;
+            for (int k = 0; k < orbitCount && carried[k] > 0; k++) {
+                int matched = 0;
+                for (int color = 0; color < 4; color++) {
+                    matched += same[k][color][renaming[p][color]];
+                }
+                bound = max(bound, (orbitSize[k] - matched + carried[k] - 1) / carried[k]);
+            }
+            best = min(best, bound);
+        }
+        return best;
+    }
+
+private:
+    StickerArray target;
+    int orbitCount;
+    int carried[64];
+    uint8_t stickerOrbitIndex[64];
+    uint8_t renaming[24][4];
+};
+
+//index of the first nonzero count
+int firstCounted(const vector<long long>& counts) {
+    size_t i = 0;
+    while (i < counts.size() && counts[i] == 0) {
+        i++;
+    }
+    return int(i);
+}
+
+//Bidirectional search in the MM family: one A* like search grows from the scrambled state with
+//the heuristic, another from the solved state with StickerDistanceBound towards the scramble.
+//Both take the node with the lowest priority max(f, 2g) over the two open lists, so neither side
+//goes past half the solution length. Every state generated on one side is looked up on the other,
+//and the best meeting U is optimal once it is no more than the lowest priority, either side's
+//lowest f, or the two lowest g plus one. States are kept with colors renamed in order of first
+//appearance, so the 24 solved colorings are a single backward root.
+vector<int> bidirectionalSolve(Pyraminx& initialPyraminx, const Heuristic& heuristic) {
+    const int FORWARD = 0;
+    const int BACKWARD = 1;
+    PackedPyraminx initialPacked(initialPyraminx);
+    StickerArray initialStickers(initialPacked);
+    Pyraminx solvedPyraminx;
+    PackedPyraminx solvedPacked(solvedPyraminx);
+    StickerDistanceBound backwardBound(initialStickers);
+
+    BucketQueue openList[2];
+    PackedStateMap bestG[2];
+    vector<SearchNode> arena[2];
+    //open entries per g and per f, stale ones included, which only makes the minimums lower
+    vector<long long> openWithG[2];
+    vector<long long> openWithF[2];
+    vector<uint8_t> nodeF[2];
+    int nodesExpanded = 0;
+
+    //best meeting so far, and the renamed state where it happened
+    int bestCost = INT_MAX;
+    PackedPyraminx meeting;
+    int meetingG[2] = {0, 0};
+
+    const PackedPyraminx roots[2] = {initialPacked, solvedPacked};
+    for (int side = 0; side < 2; side++) {
+        StickerArray stickers(roots[side]);
+        SearchNode root = {roots[side], NO_PARENT, 0, 0};
+        arena[side].push_back(root);
+        int h = side == FORWARD ? heuristic.evaluate(stickers) : backwardBound.evaluate(stickers);
+        nodeF[side].push_back(uint8_t(h));
+        openList[side].push(0, h, h);
+        openWithG[side].assign(1, 1);
+        openWithF[side].assign(h + 1, 0);
+        openWithF[side][h]++;
+        SymmetryGroup::relabel(stickers);
+        bestG[side].insert(stickers.pack(), 0);
+        if (side == BACKWARD && bestG[FORWARD].contains(stickers.pack())) {
+            bestCost = 0;
+            meeting = stickers.pack();
+        }
+    }
+
+    while (!openList[FORWARD].empty() && !openList[BACKWARD].empty()) {
+        int lowest[2];
+        int lowestF[2];
+        int lowestG[2];
+        for (int side = 0; side < 2; side++) {
+            lowest[side] = openList[side].topF();
+            lowestG[side] = firstCounted(openWithG[side]);
+            lowestF[side] = firstCounted(openWithF[side]);
+        }
+        int lowerBound = max(max(min(lowest[FORWARD], lowest[BACKWARD]), max(lowestF[FORWARD], lowestF[BACKWARD])),
+                             lowestG[FORWARD] + lowestG[BACKWARD] + 1);
+        if (bestCost <= lowerBound) {
+            break;
+        }
+
+        //expand the side with the lower priority, the smaller open list on ties
+        int side = lowest[FORWARD] < lowest[BACKWARD] ||
+                   (lowest[FORWARD] == lowest[BACKWARD] && openList[FORWARD].size() <= openList[BACKWARD].size())
+                   ? FORWARD : BACKWARD;
+        int other = 1 - side;
+        uint32_t current = openList[side].pop();
+        SearchNode node = arena[side][current];
+        openWithG[side][node.g]--;
+        openWithF[side][nodeF[side][current]]--;
+        StickerArray stickers(node.state);
+        StickerArray key = stickers;
+        SymmetryGroup::relabel(key);
+        if (node.g > *bestG[side].find(key.pack())) {
+            continue;
+        }
+        nodesExpanded++;
+
+        int lastMove = node.parent == NO_PARENT ? MoveAutomaton::START : node.move;
+        uint32_t allowedMoves = moveAutomaton.nonRedundant[lastMove];
+        for (int i = 0; i < 32; i++) {
+            if (!((allowedMoves >> i) & 1)) {
+                continue;
+            }
+            StickerArray next = stickers;
+            next.applyMove(i);
+            int newG = node.g + 1;
+            StickerArray nextKey = next;
+            SymmetryGroup::relabel(nextKey);
+            PackedPyraminx packedKey = nextKey.pack();
+            uint8_t* knownG = bestG[side].find(packedKey);
+            if (knownG != NULL && *knownG <= newG) {
+                continue;
+            }
+            bestG[side].insert(packedKey, uint8_t(newG));
+            uint8_t* otherG = bestG[other].find(packedKey);
+            if (otherG != NULL && newG + *otherG < bestCost) {
+                bestCost = newG + *otherG;
+                meeting = packedKey;
+                meetingG[side] = newG;
+                meetingG[other] = *otherG;
+            }
+            int newH = side == FORWARD ? heuristic.evaluate(next) : backwardBound.evaluate(next);
+            SearchNode newNode = {next.pack(), current, uint8_t(i), uint8_t(newG)};
+            arena[side].push_back(newNode);
+            nodeF[side].push_back(uint8_t(newG + newH));
+            openList[side].push(uint32_t(arena[side].size() - 1), max(newG + newH, 2 * newG), newH);
+            if (newG >= int(openWithG[side].size())) {
+                openWithG[side].resize(newG + 1);
+            }
+            openWithG[side][newG]++;
+            if (newG + newH >= int(openWithF[side].size())) {
+                openWithF[side].resize(newG + newH + 1);
+            }
+            openWithF[side][newG + newH]++;
+        }
+    }
+
+    if (bestCost == INT_MAX) {
+        cout << "No solution found!" << endl;
+        return vector<int>();
+    }
+    //find the node each side kept for the meeting state, then walk back the backward half
+    vector<int> moves;
+    for (int side = 0; side < 2; side++) {
+        for (size_t n = 0; n < arena[side].size(); n++) {
+            StickerArray key(arena[side][n].state);
+            SymmetryGroup::relabel(key);
+            if (arena[side][n].g == meetingG[side] && key.pack() == meeting) {
+                vector<int> half = reconstructPath(arena[side], uint32_t(n));
+                if (side == FORWARD) {
+                    moves = half;
+                } else {
+                    for (size_t k = half.size(); k-- > 0;) {
+                        moves.push_back(inverseMove[half[k]]);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    PackedPyraminx solved = initialPacked;
+    for (size_t k = 0; k < moves.size(); k++) {
+        solved.applyMove(moves[k]);
+    }
+    cout << "Solution found in " << moves.size() << " moves!" << endl;
+    solved.unpack().printPyraminx();
+    //cout << "Nodes Expanded: " << nodesExpanded << endl;
+    return moves;
+}
+
+// Tips solved apart from the rest. A tip move followed by any other move can be rewritten as
+// that move followed by a tip move: tip layers commute with every layer but the fourth rows,
+// and a fourth row turns one tip into another. So every solution has one just as long where
+// all tip moves come last, and a search over the other 24 moves only has to finish with the
+// fewest tip turns, which the tip table gives directly.
+class TipSolver {
+public:
+    static const uint32_t TIP_MOVES = 0xFFu;
+    static const uint8_t UNFIXABLE = 0xFF;
+
+    TipSolver() {
+        for (int tip = 0; tip < 4; tip++) {
+            //the three stickers of the tip and the faces they belong to
+            for (int k = 0; k < 3; k++) {
+                tipStickers[tip][k] = moveChanged[tip * 2][k];
+            }
+            //for every tip coloring and wanted face colors, the move that fixes it
+            for (int code = 0; code < 4096; code++) {
+                uint8_t stickers[64];
+                for (int k = 0; k < 3; k++) {
+                    stickers[tipStickers[tip][k]] = uint8_t((code >> (k * 2)) & 3);
+                }
+                fix[tip][code] = UNFIXABLE;
+                const int candidates[3] = {-1, tip * 2, tip * 2 + 1};
+                for (int c = 0; c < 3 && fix[tip][code] == UNFIXABLE; c++) {
+                    bool fixed = true;
+                    for (int k = 0; k < 3 && fixed; k++) {
+                        int from = candidates[c] < 0 ? tipStickers[tip][k] : moveTable[candidates[c]][tipStickers[tip][k]];
+                        fixed = stickers[from] == ((code >> (6 + k * 2)) & 3);
+                    }
+                    if (fixed) {
+                        fix[tip][code] = uint8_t(candidates[c] < 0 ? NO_MOVE : candidates[c]);
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < 64; i++) {
+            tipSticker[i] = false;
+        }
+        for (int tip = 0; tip < 4; tip++) {
+            for (int k = 0; k < 3; k++) {
+                tipSticker[tipStickers[tip][k]] = true;
+            }
+        }
+    }
+
+    //check the rewriting the solver relies on against the move tables
+    static bool tipMovesGoLast() {
+        for (int tip = 0; tip < 8; tip++) {
+            for (int move = 8; move < 32; move++) {
+                bool found = false;
+                for (int other = 0; other < 8 && !found; other++) {
+                    found = true;
+                    for (int i = 0; i < 64 && found; i++) {
+                        //tip then move, against move then other
+                        found = moveTable[tip][moveTable[move][i]] == moveTable[move][moveTable[other][i]];
+                    }
+                }
+                if (!found) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    //Fewest tip moves that solve the puzzle, or -1 if the stickers other than the tips are not
+    //solved or a tip can't be turned into place. The moves are added to tipMoves.
+    int finish(const StickerArray& stickers, vector<int>* tipMoves) const {
+        int faceColor[4];
+        for (int f = 0; f < 4; f++) {
+            faceColor[f] = -1;
+        }
+        for (int i = 0; i < 64; i++) {
+            if (tipSticker[i]) {
+                continue;
+            }
+            if (faceColor[i / 16] < 0) {
+                faceColor[i / 16] = stickers.sticker[i];
+            } else if (faceColor[i / 16] != stickers.sticker[i]) {
+                return -1;
+            }
+        }
+        int cost = 0;
+        for (int tip = 0; tip < 4; tip++) {
+            int code = 0;
+            for (int k = 0; k < 3; k++) {
+                code |= stickers.sticker[tipStickers[tip][k]] << (k * 2);
+                code |= faceColor[tipStickers[tip][k] / 16] << (6 + k * 2);
+            }
+            uint8_t move = fix[tip][code];
+            if (move == UNFIXABLE) {
+                return -1;
+            }
+            if (move != NO_MOVE) {
+                cost++;
+                if (tipMoves != NULL) {
+                    tipMoves->push_back(move);
+                }
+            }
+        }
+        return cost;
+    }
+
+private:
+    static const uint8_t NO_MOVE = 0xFE;
+
+    uint8_t tipStickers[4][3];
+    bool tipSticker[64];
+    //fix[tip][colors | wanted colors << 6]: NO_MOVE, the tip move, or UNFIXABLE
+    uint8_t fix[4][4096];
+};
+
+//IDA* search from one node, returns FOUND or the smallest f that went over the bound
+const int FOUND = -1;
+
+// How parallel IDA* splits the tree. While tasks is set, a node at depth that is not a solution
+// is added to it as a subtree task (its path) instead of being searched. Once stop is set every
+// search returns right away, another thread has the solution.
+struct IdaSplit {
+    int depth;
+    vector<vector<int> >* tasks;
+    const atomic<bool>* stop;
+};
+
+//With a tip solver only the other 24 moves are searched, and any node whose tips alone are
+//left is a solution once the tip moves fit in the bound. The same goes for a node inside the
+//perimeter table once its exact distance fits.
+int idaStarSearch(SearchState& state, int g, int h, const HeuristicCache& cache, int bound, int lastMove,
+                  const Heuristic& heuristic, vector<int>& path, long long& nodesExpanded, const TipSolver* tips,
+                  const PerimeterTable* perimeter, const IdaSplit* split = NULL) {
+    if (split != NULL && split->stop != NULL && split->stop->load(memory_order_relaxed)) {
+        return INT_MAX;
+    }
+    int f = g + h;
+    if (f > bound) {
+        return f;
+    }
+    int nextBound = INT_MAX;
+    int perimeterDistance = perimeter != NULL ? perimeter->distance(state.colors) : -1;
+    if (perimeterDistance >= 0 && g + perimeterDistance <= bound) {
+        size_t searched = path.size();
+        perimeter->appendSolution(state.colors, path);
+        for (size_t k = searched; k < path.size(); k++) {
+            state.applyMove(path[k]);
+        }
+        return FOUND;
+    }
+    if (perimeterDistance >= 0) {
+        nextBound = g + perimeterDistance;
+    }
+    if (tips != NULL) {
+        int tipCost = tips->finish(state.colors, NULL);
+        if (tipCost >= 0 && g + tipCost <= bound) {
+            size_t searched = path.size();
+            tips->finish(state.colors, &path);
+            for (size_t k = searched; k < path.size(); k++) {
+                state.applyMove(path[k]);
+            }
+            return FOUND;
+        }
+        if (tipCost >= 0) {
+            nextBound = min(nextBound, g + tipCost);
+        }
+    } else if (state.isSolved()) {
+        return FOUND;
+    }
+    //the task's own search finds the same bound again, so it is left out here
+    if (split != NULL && split->tasks != NULL && g == split->depth) {
+        split->tasks->push_back(path);
+        return INT_MAX;
+    }
+    nodesExpanded++;
+    uint32_t skippedMoves = tips != NULL ? TipSolver::TIP_MOVES : 0;
+    HeuristicCache childCache;
+    for (int i = 0; i < 32; i++) {
+        if (!moveAutomaton.allows(lastMove, i) || ((skippedMoves >> i) & 1)) {
+            continue;
+        }
+        //make the move, search below it and unmake it
+        state.applyMove(i);
+        path.push_back(i);
+        int childH = heuristic.evaluateChild(state.colors, i, cache, childCache);
+        int result = idaStarSearch(state, g + 1, childH, childCache, bound, i, heuristic, path, nodesExpanded, tips,
+                                   perimeter, split);
+        if (result == FOUND) {
+            return FOUND;
+        }
+        path.pop_back();
+        state.undoMove(i);
+        nextBound = min(nextBound, result);
+    }
+    return nextBound;
+}
+
+//IDA* algorithm, same optimal move counts as aStarSolve but memory only grows with the depth
+vector<int> idaStarSolve(Pyraminx& initialPyraminx, const Heuristic& heuristic, const TipSolver* tips = NULL,
+                         const PerimeterTable* perimeter = NULL) {
+    SearchState state(initialPyraminx);
+    vector<int> path;
+    long long nodesExpanded = 0;
+
+    HeuristicCache rootCache;
+    int rootH = heuristic.evaluateRoot(state.colors, rootCache);
+    int bound = rootH;
+    while (true) {
+        int result = idaStarSearch(state, 0, rootH, rootCache, bound, MoveAutomaton::START, heuristic, path, nodesExpanded,
+                                   tips, perimeter);
+        if (result == FOUND) {
+            cout << "Solution found in " << path.size() << " moves!" << endl;
+            PackedPyraminx solved = state.colors.pack();
+            solved.unpack().printPyraminx();
+            //cout << "Nodes Expanded: " << nodesExpanded << endl;
+            return path;
+        }
+        if (result == INT_MAX) {
+            break;
+        }
+        bound = result;
+    }
+
+    cout << "No solution found!" << endl;
+    return path;
+}
+
+//search the tasks handed out by nextTask until they run out or some thread finds a solution,
+//the first thread to find one stores its moves in solution and stops the rest
+void searchIdaTasks(const SearchState& root, const vector<vector<int> >& tasks, int bound, const Heuristic& heuristic,
+                    const TipSolver* tips, const PerimeterTable* perimeter, atomic<size_t>& nextTask,
+                    atomic<bool>& found, vector<int>& solution, int& nextBound, long long& nodesExpanded) {
+    IdaSplit split = {0, NULL, &found};
+    HeuristicCache cache;
+    while (!found.load(memory_order_relaxed)) {
+        size_t task = nextTask.fetch_add(1);
+        if (task >= tasks.size()) {
+            break;
+        }
+        //every thread keeps its own state, made from the root by the task's moves
+        SearchState state = root;
+        vector<int> path = tasks[task];
+        for (size_t k = 0; k < path.size(); k++) {
+            state.applyMove(path[k]);
+        }
+        int h = heuristic.evaluateRoot(state.colors, cache);
+        int result = idaStarSearch(state, int(path.size()), h, cache, bound, path.back(), heuristic, path, nodesExpanded,
+                                   tips, perimeter, &split);
+        if (result == FOUND) {
+            bool expected = false;
+            if (found.compare_exchange_strong(expected, true)) {
+                solution = path;
+            }
+            break;
+        }
+        nextBound = min(nextBound, result);
+    }
+}
+
+//IDA* on several threads. Each iteration splits the tree a few plies deep, deep enough for
+//TASKS_PER_THREAD tasks per thread, and the threads take tasks from a shared counter until one
+//finds a solution. Any solution inside the bound is optimal, so the first one ends the search.
+const size_t TASKS_PER_THREAD = 64;
+
+vector<int> parallelIdaStarSolve(Pyraminx& initialPyraminx, const Heuristic& heuristic, int threads,
+                                 const TipSolver* tips = NULL, const PerimeterTable* perimeter = NULL) {
+    const SearchState root(initialPyraminx);
+    long long nodesExpanded = 0;
+    threads = max(threads, 1);
+
+    HeuristicCache rootCache;
+    int rootH = heuristic.evaluateRoot(root.colors, rootCache);
+    int bound = rootH;
+    while (true) {
+        //solutions shorter than the split are found while splitting, a solved root included, so
+        //the splitting pass runs at least once whatever the bound
+        vector<vector<int> > tasks;
+        vector<int> path;
+        int result = INT_MAX;
+        for (int depth = 1; depth == 1 || depth <= bound; depth++) {
+            tasks.clear();
+            path.clear();
+            SearchState state = root;
+            IdaSplit split = {depth, &tasks, NULL};
+            result = idaStarSearch(state, 0, rootH, rootCache, bound, MoveAutomaton::START, heuristic, path, nodesExpanded,
+                                   tips, perimeter, &split);
+            if (result == FOUND || tasks.empty() || tasks.size() >= TASKS_PER_THREAD * threads) {
+                break;
+            }
+        }
+
+        if (result != FOUND && !tasks.empty()) {
+            atomic<size_t> nextTask(0);
+            atomic<bool> found(false);
+            vector<int> nextBounds(threads, INT_MAX);
+            vector<long long> expanded(threads, 0);
+            vector<thread> workers;
+            for (int t = 1; t < threads; t++) {
+                workers.push_back(thread(searchIdaTasks, cref(root), cref(tasks), bound, cref(heuristic), tips, perimeter,
+                                         ref(nextTask), ref(found), ref(path), ref(nextBounds[t]), ref(expanded[t])));
+            }
+            searchIdaTasks(root, tasks, bound, heuristic, tips, perimeter, nextTask, found, path, nextBounds[0], expanded[0]);
+            for (size_t t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            for (int t = 0; t < threads; t++) {
+                result = min(result, nextBounds[t]);
+                nodesExpanded += expanded[t];
+            }
+            if (found) {
+                result = FOUND;
+            }
+        }
+
+        if (result == FOUND) {
+            PackedPyraminx solved = root.colors.pack();
+            for (size_t k = 0; k < path.size(); k++) {
+                solved.applyMove(path[k]);
+            }
+            cout << "Solution found in " << path.size() << " moves!" << endl;
+            solved.unpack().printPyraminx();
+            //cout << "Nodes Expanded: " << nodesExpanded << endl;
+            return path;
+        }
+        if (result == INT_MAX) {
+            break;
+        }
+        bound = result;
+    }
+
+    cout << "No solution found!" << endl;
+    return vector<int>();
+}
+
+// Names for the 32 moves, in applyMove order
+string moveName(int move) {
+    static const char* layerNames[16] = {
+        "TopTip", "LeftTip", "RightTip", "BackTip",
+        "FrontSecondRow", "LeftSecondRow", "RightSecondRow", "BottomSecondRow",
+        "FrontThirdRow", "LeftThirdRow", "RightThirdRow", "BottomThirdRow",
+        "FrontFourthRow", "LeftFourthRow", "RightFourthRow", "BottomFourthRow"
+    };
+    return string(layerNames[move / 2]) + (move % 2 == 0 ? "" : "'");
+}
+
+void printMoves(const vector<int>& moves) {
+    cout << "Moves:";
+    for (size_t i = 0; i < moves.size(); i++) {
+        cout << " " << moveName(moves[i]);
+    }
+    cout << endl;
+}
+
+// Solver settings picked on the command line
+struct SolverOptions {
+    bool useIdaStar;
+    bool useSymmetry;
+    bool usePatternDatabases;
+    bool useEdgeDatabase;
+    bool useAdditiveDatabases;
+    string patternFile;
+    bool verifyPatternFile;
+    int threads;
+    PatternEncoding patternEncoding;
+    bool useClassHeuristic;
+    int verifyDepth;
+    bool useTipSolver;
+    bool useBidirectional;
+    bool useParallelIda;
+    //-1 for no perimeter table
+    int perimeterDepth;
+    string perimeterFile;
+
+    SolverOptions() : useIdaStar(false), useSymmetry(false), usePatternDatabases(false), useEdgeDatabase(false),
+                      useAdditiveDatabases(false), verifyPatternFile(false), threads(max(1, int(thread::hardware_concurrency()))),
+                      patternEncoding(BYTE_ENCODING), useClassHeuristic(false), verifyDepth(-1),
+                      useTipSolver(false), useBidirectional(false), useParallelIda(false),
+                      perimeterDepth(-1) {}
+};
+
+//tips is the tip solver when the tips are solved apart, it always searches with IDA*
+//perimeter is the perimeter table when there is one, heuristic already includes its bound
+void solve(Pyraminx& pyraminx, const SolverOptions& options, const Heuristic& heuristic, const TipSolver* tips,
+           const PerimeterTable* perimeter) {
+    vector<int> moves;
+    if (options.useBidirectional) {
+        moves = bidirectionalSolve(pyraminx, heuristic);
+    } else if (options.useParallelIda) {
+        moves = parallelIdaStarSolve(pyraminx, heuristic, options.threads, tips, perimeter);
+    } else if (options.useIdaStar || tips != NULL) {
+        moves = idaStarSolve(pyraminx, heuristic, tips, perimeter);
+    } else {
+        moves = aStarSolve(pyraminx, heuristic, perimeter);
+    }
+    printMoves(moves);
+}
+
+int main(int argc, char* argv[]) {
+    SolverOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--ida") {
+            options.useIdaStar = true;
+        } else if (arg == "--parallel-ida") {
+            options.useParallelIda = true;
+        } else if (arg == "--symmetry") {
+            options.useSymmetry = true;
+        } else if (arg == "--pdb") {
+            options.usePatternDatabases = true;
+        } else if (arg == "--pdb-edges") {
+            options.usePatternDatabases = true;
+            options.useEdgeDatabase = true;
+        } else if (arg == "--pdb-additive") {
+            options.usePatternDatabases = true;
+            options.useAdditiveDatabases = true;
+        } else if (arg == "--pdb-file" && i + 1 < argc) {
+            options.usePatternDatabases = true;
+            options.patternFile = argv[++i];
+        } else if (arg == "--pdb-verify") {
+            options.verifyPatternFile = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = max(1, atoi(argv[++i]));
+        } else if (arg == "--pdb-encoding" && i + 1 < argc && string(argv[i + 1]) == "byte") {
+            options.patternEncoding = BYTE_ENCODING;
+            i++;
+        } else if (arg == "--pdb-encoding" && i + 1 < argc && string(argv[i + 1]) == "nibble") {
+            options.patternEncoding = NIBBLE_ENCODING;
+            i++;
+        } else if (arg == "--pdb-encoding" && i + 1 < argc && string(argv[i + 1]) == "mod3") {
+            options.patternEncoding = MOD3_ENCODING;
+            i++;
+        } else if (arg == "--heuristic" && i + 1 < argc && string(argv[i + 1]) == "sticker") {
+            options.useClassHeuristic = false;
+            i++;
+        } else if (arg == "--heuristic" && i + 1 < argc && string(argv[i + 1]) == "class") {
+            options.useClassHeuristic = true;
+            i++;
+        } else if (arg == "--bidirectional") {
+            options.useBidirectional = true;
+        } else if (arg == "--perimeter" && i + 1 < argc) {
+            options.perimeterDepth = max(0, atoi(argv[++i]));
+        } else if (arg == "--perimeter-file" && i + 1 < argc) {
+            options.perimeterFile = argv[++i];
+        } else if (arg == "--tips") {
+            options.useTipSolver = true;
+        } else if (arg == "--verify-heuristic" && i + 1 < argc) {
+            options.verifyDepth = max(0, atoi(argv[++i]));
+        } else {
+            cout << "Unknown option: " << arg << endl;
+            cout << "Options: --ida (iterative deepening A*), --symmetry (merge symmetric states)," << endl;
+            cout << "         --parallel-ida (IDA* on --threads threads, subtrees shared out as tasks)," << endl;
+            cout << "         --pdb (pattern database heuristic), --pdb-edges (also the large edge database)," << endl;
+            cout << "         --pdb-additive (also partitions of tip and center databases that add up)," << endl;
+            cout << "         --pdb-file FILE (map the databases from FILE, building it if needed)," << endl;
+            cout << "         --pdb-verify (check the table checksums when mapping)," << endl;
+            cout << "         --threads N (threads for building pattern databases and for --parallel-ida, default all cores)," << endl;
+            cout << "         --pdb-encoding byte|nibble|mod3 (bits per pattern database entry: 8, 4 or 2)," << endl;
+            cout << "         --heuristic sticker|class (findHeuristic's bound, or the bound per location class)," << endl;
+            cout << "         --tips (IDA* without tip moves, tips are turned into place at the end)," << endl;
+            cout << "         --bidirectional (search from the scramble and from solved at once)," << endl;
+            cout << "         --perimeter K (table of every state within K moves of solved, stop on reaching it)," << endl;
+            cout << "         --perimeter-file FILE (map the perimeter table from FILE, building it if needed, K is 4 if not given)," << endl;
+            cout << "         --verify-heuristic N (check the heuristic against every state within N moves and exit)" << endl;
+            return 1;
+        }
+    }
+
+    initSolverTables();
+    if (options.useSymmetry) {
+        initSymmetries(true, true);
+        cout << "Symmetries in use: " << symmetryGroup.size() << endl;
+    }
+    TipSolver tipMoveTable;
+    const TipSolver* tipSolver = NULL;
+    if (options.useTipSolver) {
+        if (TipSolver::tipMovesGoLast()) {
+            tipSolver = &tipMoveTable;
+        } else {
+            cout << "Tip moves can't always be moved to the end, searching with every move" << endl;
+        }
+    }
+
+    //pick the heuristic, the pattern databases are built once for all five puzzles
+    StickerHeuristic stickerHeuristic;
+    ClassStickerHeuristic classStickerHeuristic;
+    PatternHeuristic patternHeuristic;
+    PatternDatabaseSet databases;
+    const Heuristic* heuristic = &stickerHeuristic;
+    if (options.useClassHeuristic) {
+        heuristic = &classStickerHeuristic;
+    }
+    PatternFile patternFile;
+    if (options.usePatternDatabases) {
+        if (options.patternFile.empty()) {
+            databases = buildPatternDatabases(options.useEdgeDatabase, options.useAdditiveDatabases, options.threads,
+                                              options.patternEncoding);
+        } else {
+            databases = loadPatternDatabases(options.patternFile, options.useEdgeDatabase, options.useAdditiveDatabases,
+                                             options.verifyPatternFile, options.threads, options.patternEncoding, patternFile);
+        }
+        patternHeuristic.addDatabases(databases);
+        heuristic = &patternHeuristic;
+    }
+    if (options.perimeterDepth < 0 && !options.perimeterFile.empty()) {
+        options.perimeterDepth = 4;
+    }
+    PerimeterTable perimeterTable;
+    const PerimeterTable* perimeter = NULL;
+    PatternFile perimeterFile;
+    PerimeterHeuristic perimeterHeuristic(*heuristic, perimeterTable);
+    if (options.perimeterDepth >= 0) {
+        loadPerimeterTable(options.perimeterFile, options.perimeterDepth, options.verifyPatternFile, perimeterTable,
+                           perimeterFile);
+        perimeter = &perimeterTable;
+        heuristic = &perimeterHeuristic;
+    }
+
+    if (options.verifyDepth >= 0) {
+        bool admissible = verifyHeuristic(*heuristic, options.verifyDepth);
+        for (size_t d = 0; d < databases.databases.size(); d++) {
+            delete databases.databases[d];
+        }
+        return admissible ? 0 : 1;
+    }
+
+    //Handles user input to determine how many random moves to perform
+    int userInput = 0;
+    cout << "Input the number of random rotations to perform:" << endl;
+    cin >> userInput;
+    if (userInput < 0) {
+        cout << "Invalid input" << endl;
+        return 1;
+    }
+
+    //creates the pyraminx in the solved state
+    Pyraminx pyraminx;
+    Pyraminx pyraminx2;
+    Pyraminx pyraminx3;
+    Pyraminx pyraminx4;
+    Pyraminx pyraminx5;
+
+    //calls the randomizer and prints the random moves
+    for (int i = 0; i < userInput; i++) {
+        pyraminx.randomizer();
+        pyraminx2.randomizer();
+        pyraminx3.randomizer();
+        pyraminx4.randomizer();
+        pyraminx5.randomizer();
+    }
+    cout << "Pyraminx 1:" << endl;
+    pyraminx.printPyraminx();
+    cout << "Heuristic: " << pyraminx.findHeuristic() << endl;
+    cout << endl << "Pyraminx 2:" << endl;
+    pyraminx2.printPyraminx();
+    cout << "Heuristic: " << pyraminx2.findHeuristic() << endl;
+    cout << endl << "Pyraminx 3:" << endl;
+    pyraminx3.printPyraminx();
+    cout << "Heuristic: " << pyraminx3.findHeuristic() << endl;
+    cout << endl << "Pyraminx 4:" << endl;
+    pyraminx4.printPyraminx();
+    cout << "Heuristic: " << pyraminx4.findHeuristic() << endl;
+    cout << endl << "Pyraminx 5:" << endl;
+    pyraminx5.printPyraminx();
+    cout << "Heuristic: " << pyraminx5.findHeuristic() << endl;
+
+    cout << endl << "Pyraminx 1:" << endl;
+    solve(pyraminx, options, *heuristic, tipSolver, perimeter);
+    cout << endl << "Pyraminx 2:" << endl;
+    solve(pyraminx2, options, *heuristic, tipSolver, perimeter);
+    cout << endl << "Pyraminx 3:" << endl;
+    solve(pyraminx3, options, *heuristic, tipSolver, perimeter);
+    cout << endl << "Pyraminx 4:" << endl;
+    solve(pyraminx4, options, *heuristic, tipSolver, perimeter);
+    cout << endl << "Pyraminx 5:" << endl;
+    solve(pyraminx5, options, *heuristic, tipSolver, perimeter);
+
+    for (size_t d = 0; d < databases.databases.size(); d++) {
+        delete databases.databases[d];
+    }
     return 0;
 }